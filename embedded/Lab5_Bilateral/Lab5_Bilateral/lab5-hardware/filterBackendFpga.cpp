@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <string.h>
+#include <CL/cl_ext_xilinx.h>
+#include "filterCommon.h"
+#include "filterBackend.h"
+#include "filterTrace.h"
+#include "filterSession.h"
+#include "filterBuffers.h"
+
+/***********************************************************
+ * FPGA backend of the filter driver (lab5-software/filter.c,
+ * built here with make bench). Runs the kernel of the xclbin
+ * through a filter session, with one row band per compute
+ * unit over the whole frames. The caller's frames are used
+ * in place when they are page aligned, which frame_alloc()
+ * memory is. Built with DEPTH_U16 (make DEPTH=u16) it runs
+ * the uint16 kernel and only takes uint16 frames.
+ * *********************************************************/
+
+#ifndef KERNEL_NAME
+#define KERNEL_NAME "bilateralFilterKernel" // Kernel instance in the xclbin (make KERNEL_NAME=...)
+#endif
+#ifndef PIXELS_PER_CYCLE
+#define PIXELS_PER_CYCLE 1 // Must match the kernel build (make PPC=...)
+#endif
+#define FPGA_MAX_BANDS 16 // Largest number of row bands (one per compute unit)
+#define FPGA_MAX_RADIUS 4 // Largest radius of the kernel instances (R4W640)
+
+static filter_session fpga_session;
+static cl_kernel fpga_kernels[FPGA_MAX_BANDS];
+static int fpga_bands;
+#ifndef SPATIAL_ROM
+// Filter vector on the device, rewritten when the caller's one changes
+static cl_mem fpga_gaussian;
+static float fpga_weights[2 * FPGA_MAX_RADIUS + 1];
+static int fpga_weight_count;
+#endif
+
+/***********************************************************
+ * Function:  fpga_open
+ * *********************************************************/
+static int fpga_open(const char *xclbin){
+    cl_uint compute_units = 1;
+    int b;
+
+    if (!xclbin) {
+        printf("Error: the %s backend needs an xclbin\n", fpga_backend.name);
+        return -1;
+    }
+    if (session_open(&fpga_session, xclbin, KERNEL_NAME) != 0) {
+        return -1;
+    }
+    if (clGetKernelInfo(session_kernel(&fpga_session, 0), CL_KERNEL_COMPUTE_UNIT_COUNT, sizeof(cl_uint),
+                        &compute_units, NULL) != CL_SUCCESS) {
+        compute_units = 1;
+    }
+    fpga_bands = MIN((int) compute_units, FPGA_MAX_BANDS);
+    for (b = 0; b < fpga_bands; b++) {
+        fpga_kernels[b] = session_kernel(&fpga_session, b);
+        if (!fpga_kernels[b]) {
+            session_close(&fpga_session);
+            return -1;
+        }
+    }
+#ifndef SPATIAL_ROM
+    cl_int err;
+    fpga_gaussian = session_buffer(&fpga_session, CL_MEM_READ_ONLY, sizeof(fpga_weights), NULL, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create the gaussian buffer! %d\n", err);
+        session_close(&fpga_session);
+        return -1;
+    }
+    fpga_weight_count = 0;
+#endif
+    return 0;
+}
+
+/***********************************************************
+ * Function:  fpga_filter
+ * ---------------------------------------------------------
+ * One request: takes the frame buffers from the session
+ * pool, migrates the input, runs every band and migrates
+ * the output back, then waits for it. in holds frames of
+ * in_pixel bytes per pixel.
+ * *********************************************************/
+static int fpga_filter(float *out, const void *in, size_t in_pixel, const float *gaussian, int size_x, int size_y,
+                       int r, int frames){
+    size_t size = sizeof(float) * size_x * size_y * frames;
+    cl_command_queue q = fpga_session.hardware.mQueue;
+    cl_event h2d_event, d2h_event, kernel_events[FPGA_MAX_BANDS];
+    cl_mem input_buffer, output_buffer;
+    cl_uint kernel_count = 0;
+    int frame_stride = size_x * size_y;
+    int row_begin, row_end, band_rows, row0 = 0;
+    int argcounter, b, k;
+    cl_int err;
+
+    if (size_x % PIXELS_PER_CYCLE != 0) {
+        printf("Error: image width %d is not a multiple of %d pixels per cycle\n", size_x, PIXELS_PER_CYCLE);
+        return -1;
+    }
+#ifndef SPATIAL_ROM
+    if (2 * r + 1 > (int) (sizeof(fpga_weights) / sizeof(float))) {
+        printf("Error: radius %d is too large for the kernel\n", r);
+        return -1;
+    }
+    if (fpga_weight_count != 2 * r + 1 || memcmp(fpga_weights, gaussian, sizeof(float) * (2 * r + 1)) != 0) {
+        fpga_weight_count = 2 * r + 1;
+        memcpy(fpga_weights, gaussian, sizeof(float) * fpga_weight_count);
+        err = clEnqueueWriteBuffer(q, fpga_gaussian, CL_TRUE, 0, sizeof(float) * fpga_weight_count, fpga_weights,
+                                   0, NULL, NULL);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to write the gaussian buffer! %d\n", err);
+            return -1;
+        }
+    }
+#endif
+
+    TRACE_SCOPE("fpga request");
+    input_buffer = session_buffer(&fpga_session, CL_MEM_READ_ONLY, in_pixel * size_x * size_y * frames, (void *) in,
+                                  &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get input buffer! %d\n", err);
+        return -1;
+    }
+    output_buffer = session_buffer(&fpga_session, CL_MEM_WRITE_ONLY, size, out, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get output buffer! %d\n", err);
+        session_return(&fpga_session, input_buffer);
+        return -1;
+    }
+
+    err = clEnqueueMigrateMemObjects(q, 1, &input_buffer, 0, 0, NULL, &h2d_event);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to migrate memobjects to device! %d\n", err);
+        session_return(&fpga_session, input_buffer);
+        session_return(&fpga_session, output_buffer);
+        return -1;
+    }
+
+    band_rows = (size_y + fpga_bands - 1) / fpga_bands;
+    for (b = 0; b < fpga_bands; b++) {
+        row_begin = MIN(b * band_rows, size_y);
+        row_end = MIN(row_begin + band_rows, size_y);
+        if (row_begin == row_end) {
+            continue;
+        }
+        argcounter = 0;
+        err = clSetKernelArg(fpga_kernels[b], argcounter++, sizeof(cl_mem), &output_buffer);
+        err |= clSetKernelArg(fpga_kernels[b], argcounter++, sizeof(cl_mem), &input_buffer);
+#ifndef SPATIAL_ROM
+        err |= clSetKernelArg(fpga_kernels[b], argcounter++, sizeof(cl_mem), &fpga_gaussian);
+#endif
+        err |= clSetKernelArg(fpga_kernels[b], argcounter++, sizeof(int), &size_x);
+        err |= clSetKernelArg(fpga_kernels[b], argcounter++, sizeof(int), &size_y);
+        err |= clSetKernelArg(fpga_kernels[b], argcounter++, sizeof(int), &r);
+        err |= clSetKernelArg(fpga_kernels[b], argcounter++, sizeof(int), &frames);
+        err |= clSetKernelArg(fpga_kernels[b], argcounter++, sizeof(int), &frame_stride);
+        err |= clSetKernelArg(fpga_kernels[b], argcounter++, sizeof(int), &row_begin);
+        err |= clSetKernelArg(fpga_kernels[b], argcounter++, sizeof(int), &row_end);
+        err |= clSetKernelArg(fpga_kernels[b], argcounter++, sizeof(int), &row0);
+        err |= clSetKernelArg(fpga_kernels[b], argcounter++, sizeof(int), &row0);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to set bilateralFilterKernel arguments! %d\n", err);
+            goto done;
+        }
+        err = clEnqueueTask(q, fpga_kernels[b], 1, &h2d_event, &kernel_events[kernel_count]);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to execute kernel! %d\n", err);
+            goto done;
+        }
+        kernel_count++;
+    }
+
+    err = clEnqueueMigrateMemObjects(q, 1, &output_buffer, CL_MIGRATE_MEM_OBJECT_HOST, kernel_count,
+                                     kernel_events, &d2h_event);
+    if (err == CL_SUCCESS) {
+        err = clWaitForEvents(1, &d2h_event);
+        clReleaseEvent(d2h_event);
+    }
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to migrate membojects from device: %d!\n", err);
+    }
+
+done:
+    // On errors the commands already enqueued may still use the
+    // buffers, so they drain before the buffers go back to the pool
+    if (err != CL_SUCCESS) {
+        clFinish(q);
+    }
+    clReleaseEvent(h2d_event);
+    for (k = 0; k < (int) kernel_count; k++) {
+        clReleaseEvent(kernel_events[k]);
+    }
+    session_return(&fpga_session, input_buffer);
+    session_return(&fpga_session, output_buffer);
+    return err == CL_SUCCESS ? 0 : -1;
+}
+
+#ifdef DEPTH_U16
+static int fpga_filter_u16(float *out, const uint16_t *in, const float *gaussian, int size_x, int size_y, int r,
+                           int frames){
+    return fpga_filter(out, in, sizeof(uint16_t), gaussian, size_x, size_y, r, frames);
+}
+#else
+static int fpga_filter_f32(float *out, const float *in, const float *gaussian, int size_x, int size_y, int r,
+                           int frames){
+    return fpga_filter(out, in, sizeof(float), gaussian, size_x, size_y, r, frames);
+}
+#endif
+
+/***********************************************************
+ * Function:  fpga_close
+ * *********************************************************/
+static void fpga_close(void){
+    session_close(&fpga_session);
+}
+
+#ifdef DEPTH_U16
+#define FPGA_FILTERS NULL, fpga_filter_u16
+#else
+#define FPGA_FILTERS fpga_filter_f32, NULL
+#endif
+#ifdef CLMOCK
+const filter_backend fpga_backend = {"mock", fpga_open, FPGA_FILTERS, fpga_close, 1};
+#else
+const filter_backend fpga_backend = {"fpga", fpga_open, FPGA_FILTERS, fpga_close, 1};
+#endif
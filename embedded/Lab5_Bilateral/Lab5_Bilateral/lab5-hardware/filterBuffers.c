@@ -0,0 +1,58 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "filterBuffers.h"
+
+/***********************************************************
+ * Function:  frame_buffer
+ * ---------------------------------------------------------
+ * The runtime accepts an unaligned host pointer and falls
+ * back to a copy, so the only sign of it would be a slower
+ * migration. Warn instead.
+ * *********************************************************/
+cl_mem frame_buffer(cl_context context, cl_mem_flags flags, void *host, size_t size, const char *name,
+                    cl_int *err){
+    if (!frame_is_aligned(host)) {
+        printf("WARNING: %s at %p is not %d byte aligned, every migration will copy it\n",
+               name, host, FRAME_ALIGNMENT);
+    }
+    return clCreateBuffer(context, flags | CL_MEM_USE_HOST_PTR, size, host, err);
+}
+
+/***********************************************************
+ * Function:  band_row_quantum
+ * ---------------------------------------------------------
+ * The least common multiple of the row size and the origin
+ * alignment (given in bits by the device), in rows.
+ * *********************************************************/
+int band_row_quantum(cl_device_id device, size_t row_bytes){
+    cl_uint align_bits = 0;
+    size_t align, rows = 1;
+
+    if (clGetDeviceInfo(device, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(cl_uint), &align_bits, NULL) != CL_SUCCESS ||
+        align_bits < 8) {
+        return 1;
+    }
+    align = align_bits / 8;
+    while ((rows * row_bytes) % align != 0) {
+        rows++;
+    }
+    return (int) rows;
+}
+
+/***********************************************************
+ * Function:  band_buffer
+ * ---------------------------------------------------------
+ * With several frames the region runs from the band of the
+ * first frame to the band of the last one, so the bands of
+ * a batch overlap. OpenCL leaves concurrent writes to
+ * overlapping sub-buffers undefined, even to disjoint
+ * bytes, so only read-only buffers are split this way.
+ * *********************************************************/
+cl_mem band_buffer(cl_mem parent, cl_mem_flags flags, size_t row_bytes, size_t frame_bytes, int frames,
+                   int row_begin, int row_end, cl_int *err){
+    cl_buffer_region region;
+
+    region.origin = row_begin * row_bytes;
+    region.size = (frames - 1) * frame_bytes + (row_end - row_begin) * row_bytes;
+    return clCreateSubBuffer(parent, flags, CL_BUFFER_CREATE_TYPE_REGION, &region, err);
+}
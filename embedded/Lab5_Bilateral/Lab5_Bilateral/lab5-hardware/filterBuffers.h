@@ -0,0 +1,52 @@
+#ifndef _FILTER_BUFFERS_H_
+#define _FILTER_BUFFERS_H_
+
+/***********************************************************
+ * Frame buffers shared between the host and the device.
+ *
+ * A buffer created with CL_MEM_USE_HOST_PTR on page aligned
+ * memory is used by the device in place: on the ZCU102 XRT
+ * only flushes or invalidates the caches on migration, with
+ * no copy. Any other pointer makes XRT allocate its own
+ * buffer and memcpy the frame on every migration, silently.
+ * frame_buffer() warns when that happens.
+ *
+ * Memory from frame_alloc() (lab5-software/filterCommon.h)
+ * is always aligned. Frames of other sources (a camera
+ * driver, a file mapped with mmap) can be handed over
+ * directly when their base is page aligned, which mmap and
+ * V4L2 buffers are.
+ *
+ * Row bands of an input frame buffer are sub-buffers of
+ * it: the compute units share one allocation and one
+ * migration, and a band only sees the rows from its halo
+ * down. Outputs are not split, see band_buffer. A
+ * sub-buffer must start at a multiple of the device's
+ * CL_DEVICE_MEM_BASE_ADDR_ALIGN, so band rows are rounded
+ * to band_row_quantum().
+ * *********************************************************/
+
+#ifndef CL_TARGET_OPENCL_VERSION
+#define CL_TARGET_OPENCL_VERSION 120
+#endif
+#include <CL/cl.h>
+#include "filterCommon.h" // frame_alloc, frame_is_aligned
+
+// Creates a buffer over size bytes of host memory at host,
+// with CL_MEM_USE_HOST_PTR added to flags. Warns, naming the
+// buffer name, if host is not aligned.
+cl_mem frame_buffer(cl_context context, cl_mem_flags flags, void *host, size_t size, const char *name,
+                    cl_int *err);
+
+// Smallest row count such that every multiple of it starts a
+// row at a valid sub-buffer origin
+int band_row_quantum(cl_device_id device, size_t row_bytes);
+
+// Creates a sub-buffer of parent holding rows [row_begin,
+// row_end) of every frame, the frames frame_bytes apart.
+// row_begin must be a multiple of band_row_quantum(). For
+// read-only buffers: the bands of a batch overlap.
+cl_mem band_buffer(cl_mem parent, cl_mem_flags flags, size_t row_bytes, size_t frame_bytes, int frames,
+                   int row_begin, int row_end, cl_int *err);
+
+#endif
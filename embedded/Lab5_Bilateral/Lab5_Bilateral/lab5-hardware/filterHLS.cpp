@@ -1,16 +1,69 @@
 #include <math.h>
+#include <stddef.h>
+#include "filterHLS.h"
+#ifdef FILTER_STATS
+#include "filterStats.h" // Workload counters, host builds of the kernel only (make STATS=yes TARGET=mock)
+#endif
 
-#define MIN(a,b) (((a)<(b))?(a):(b))
-#define MAX(a,b) (((a)>(b))?(a):(b))
+/***********************************************************
+ * Kernel configuration
+ * ---------------------------------------------------------
+ * PIXELS_PER_CYCLE (P) is the number of output pixels the
+ * pipeline produces every clock cycle. It can be overridden
+ * from the Makefile (make bin PPC=<1|2|4|8>). The image width
+ * given at runtime must be a multiple of P.
+ *
+ * Every lane replicates the (2r+1)x(2r+1) tap datapath, the
+ * line buffers are split in P cyclic banks and the m_axi
+ * ports are widened to P floats, so one input and one output
+ * vector move per cycle.
+ *
+ * Estimated cost per P for r = 2 on the ZCU102 (XCZU9EG,
+ * 2520 DSP, 912 BRAM18K) at the default 100 MHz clock.
+ * DSP figures come from the operator count of one lane
+ * (25 taps x ~25 DSP for fsub, 4 fmul, 2 fadd and expf),
+ * they are not post-synthesis numbers. BRAM18K counts the
+ * line buffers of the default kernel, LINE_ROWS = 7 rows of
+ * MAX_W = 1920 floats in P cyclic banks of 1920 / P x 32
+ * bit: 4 BRAM18K per row while a bank is 512 deep or more,
+ * 1 per bank (512 x 36) below, so 8 per row at P = 8:
+ *
+ *   P | Mpixel/s | 320x240 fps | m_axi width | DSP (est.) | BRAM18K
+ *  ---+----------+-------------+-------------+------------+--------
+ *   1 |      100 |       ~1300 |     32 bit  |   ~625     |  ~28
+ *   2 |      200 |       ~2600 |     64 bit  |  ~1250     |  ~28
+ *   4 |      400 |       ~5200 |    128 bit  |  ~2500     |  ~28
+ *   8 |      800 |      ~10400 |    256 bit  |  ~5000 (!) |  ~56
+ *
+ * P = 4 fills the device and P = 8 does not fit the XCZU9EG
+ * with a full float datapath. The fps column ignores the
+ * per-row pipeline fill (~50 cycles) and the r + 1 row
+ * start-up latency.
+ * *********************************************************/
 
-/**
- * Extern is a requirement for Vitis Unified Software Platform,
- * when we use a .cpp (C++ source code) file.
- * */
-extern "C" {
+/***********************************************************
+ * Window geometry for a kernel supporting radii up to
+ * MAX_R and image widths up to MAX_W. Sizes are compile
+ * time constants, so the tap loops unroll completely and the
+ * line buffers are sized exactly.
+ * *********************************************************/
+template <int MAX_R, int MAX_W>
+struct FilterGeometry {
+	static const int WINDOW_SIZE = 2 * MAX_R + 1;
+	// Vectors needed on each side of the center vector
+	static const int WINDOW_HALO = (MAX_R + PIXELS_PER_CYCLE - 1) / PIXELS_PER_CYCLE;
+	static const int WINDOW_COLS = (2 * WINDOW_HALO + 1) * PIXELS_PER_CYCLE;
+	// Ring of 2r+2 rows (2r+1 being read, 1 being written) plus the border row
+	static const int RING_ROWS = 2 * MAX_R + 2;
+	static const int BORDER_ROW = RING_ROWS;
+	static const int LINE_ROWS = RING_ROWS + 1;
+	static const int MAX_VECS = MAX_W / PIXELS_PER_CYCLE;
+	// Only used for latency estimates in the HLS reports (4:3 frames)
+	static const int TYPICAL_ROWS = MAX_W * 3 / 4;
+};
 
 /***********************************************************
- * Function:  bilateralFilterKernel
+ * Function:  bilateralFilterCore
  * ---------------------------------------------------------
  * Applies a vector filter on a SIZE_X x SIZE_Y input image.
  *
@@ -21,78 +74,348 @@ extern "C" {
  *    |              |     |        |    |              |
  *    +--------------+     +--------+    +--------------+
  *
+ * Input rows are streamed once into on-chip line buffers.
+ * Output row y is computed while row y + r + 1 is being read,
+ * so all 2r+1 rows it needs are complete in the buffers. A
+ * shift register window slides over them one vector (P pixels)
+ * per cycle.
+ *
+ * Borders follow the reference implementation: any tap that
+ * falls outside the image (on either side) reads the last
+ * row / last column, which is why row size_y - 1 is fetched
+ * first into its own buffer.
  *
  *  out: The output image after the filter was applied.
  *
  *  in: The input image.
  *
- *  gaussian: A 5 element vector that holds the filter values.
+ *  gaussian: A 2r+1 element vector that holds the filter values.
+ *
+ *  frames: Number of frames in in/out, filtered back to back.
+ *
+ *  frame_stride: Distance in pixels between consecutive frames
+ *  (size_x * size_y for packed frames), a multiple of P.
+ *
+ *  row_begin, row_end: Band of output rows [row_begin, row_end)
+ *  to compute. Input rows up to r above and below the band
+ *  (the halo) are read as well.
+ *
+ *  in_row0, out_row0: Frame rows held at in[0] and out[0], so
+ *  that in and out may cover only part of a frame. in must
+ *  cover the band plus its halo, and row size_y - 1 too when
+ *  the halo crosses the top or the bottom of the frame.
+ *
+ *  MAX_R, MAX_W: Largest radius and image width the instance
+ *  supports. The runtime r and size_x must not exceed them.
+ *
+ *  ROM_WEIGHTS: Use the spatialRom weights instead of reading
+ *  gaussian (which may then be NULL). Needs MAX_R <= 4.
+ *
+ *  IN_VEC: pixel_vec for float frames, depth_vec for uint16
+ *  depth frames. Input pixels are converted to float by the
+ *  reader, before they enter the line buffers.
  *************************************************************/
-void bilateralFilterKernel(float* out, float* in,float* gaussian,int size_x,int size_y,int r) {
+template <int MAX_R, int MAX_W, bool ROM_WEIGHTS, typename IN_VEC>
+void bilateralFilterCore(pixel_vec* out, const IN_VEC* in, const float* gaussian, int size_x, int size_y, int r,
+		int frames, int frame_stride, int row_begin, int row_end, int in_row0, int out_row0) {
+	typedef FilterGeometry<MAX_R, MAX_W> G;
+
+	float lineBuffer[G::LINE_ROWS][MAX_W];
+	#pragma HLS ARRAY_PARTITION variable=lineBuffer complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=lineBuffer cyclic factor=PIXELS_PER_CYCLE dim=2
+	#pragma HLS DEPENDENCE variable=lineBuffer inter false
+
+	float window[G::WINDOW_SIZE][G::WINDOW_COLS];
+	#pragma HLS ARRAY_PARTITION variable=window complete dim=0
+
+	float spatial[G::WINDOW_SIZE];
+	#pragma HLS ARRAY_PARTITION variable=spatial complete
 
-    /*** Required INTERFACE pragma START ***/
-	#pragma HLS INTERFACE s_axilite port=return bundle=control
+	int source[G::WINDOW_SIZE];
+	#pragma HLS ARRAY_PARTITION variable=source complete
+	float edge[G::WINDOW_SIZE];
+	#pragma HLS ARRAY_PARTITION variable=edge complete
 
-	#pragma HLS INTERFACE m_axi port=out offset=slave bundle=gmem
-	#pragma HLS INTERFACE s_axilite port=out	bundle=control
+	int i,j,k,p,c,s,t,f;
+	const int vecs = size_x / PIXELS_PER_CYCLE;
+	const int strideVecs = frame_stride / PIXELS_PER_CYCLE;
+	// Input rows of the band and its halo that lie inside the frame
+	const int readBegin = MAX(0, row_begin - r);
+	const int readEnd = MIN(size_y, row_end + r);
+	const bool needBorder = row_begin - r < 0 || row_end + r > size_y;
 
-	#pragma HLS INTERFACE m_axi port=in offset=slave bundle=gmem
-	#pragma HLS INTERFACE s_axilite port=in	bundle=control
+	// Sizes this instance was not built for would overrun the buffers
+	if (r > MAX_R || size_x > MAX_W || size_x % PIXELS_PER_CYCLE != 0 ||
+			frame_stride % PIXELS_PER_CYCLE != 0 ||
+			row_begin < 0 || row_end > size_y || row_begin >= row_end) {
+		return;
+	}
 
-	#pragma HLS INTERFACE m_axi port=gaussian offset=slave bundle=gmem
-	#pragma HLS INTERFACE s_axilite port=gaussian	bundle=control
-    /*** Required INTERFACE pragma END ***/
+	// The filter vector is read once instead of twice per tap
+	if (!ROM_WEIGHTS) {
+		for (i = -MAX_R; i <= MAX_R; i++) {
+			#pragma HLS PIPELINE II=1
+			spatial[i + MAX_R] = (i >= -r && i <= r) ? gaussian[i + r] : 0.0f;
+		}
+	}
 
-	#pragma HLS INTERFACE s_axilite port=size_x bundle=control
-	#pragma HLS INTERFACE s_axilite port=size_y bundle=control
-	#pragma HLS INTERFACE s_axilite port=r bundle=control
+	// Frames are processed back to back, with one launch per batch
+	for (f = 0; f < frames; f++) {
+		#pragma HLS LOOP_TRIPCOUNT min=1 max=16
+		const IN_VEC* frameIn = in + f * strideVecs;
+		pixel_vec* frameOut = out + f * strideVecs;
 
-	int i,j;
-	unsigned int x,y,pos;
+		// Border row, read by every tap above or below the image
+		for (t = 0; t < (needBorder ? vecs : 0); t++) {
+			#pragma HLS PIPELINE II=1
+			#pragma HLS LOOP_TRIPCOUNT min=1 max=G::MAX_VECS
+			const IN_VEC v = frameIn[(size_y - 1 - in_row0) * vecs + t];
+			for (p = 0; p < PIXELS_PER_CYCLE; p++) {
+				lineBuffer[G::BORDER_ROW][t * PIXELS_PER_CYCLE + p] = depth_pixel(v.data[p]);
+			}
+		}
 
-	for (y = 0; y < size_y; y++) {
-	/* Vitis automatically enables SW pipelining. 
-       The following pragma disables pipelining. 
-	   You have to replace it with the appopriate pragmas
-       to enable optimizations */	   
-		#pragma HLS PIPELINE off      
-		for (x = 0; x < size_x; x++) {
-					#pragma HLS PIPELINE off
+		for (s = 0; s < row_end - row_begin + 2 * r + 1; s++) {
+			#pragma HLS LOOP_TRIPCOUNT min=1 max=G::TYPICAL_ROWS
+			const int rowIn = row_begin - r + s;         // Row read during this step
+			const int y = row_begin - 2 * r - 1 + s;     // Row computed during this step
+			const bool doRead = rowIn >= readBegin && rowIn < readEnd;
+			const bool doCompute = y >= row_begin;
+			const int writeRow = (rowIn + G::RING_ROWS) % G::RING_ROWS;
 
-			pos = x + y * size_x;
-			if (in[pos] == 0) {
-				out[pos] = 0;
+			if (!doRead && !doCompute) {
 				continue;
 			}
 
-			float sum = 0.0f;
-			float t = 0.0f;
+			// Pick the buffer row feeding every window row
+			for (k = 0; k < G::WINDOW_SIZE; k++) {
+				#pragma HLS UNROLL
+				const int yy = y + k - MAX_R;
+				source[k] = (yy < 0 || yy >= size_y) ? G::BORDER_ROW : yy % G::RING_ROWS;
+				edge[k] = lineBuffer[source[k]][size_x - 1];
+			}
 
-			const float center = in[pos];
+			// Columns left of the image are read from edge, but the
+			// window starts every row defined
+			for (k = 0; k < G::WINDOW_SIZE; k++) {
+				#pragma HLS UNROLL
+				for (c = 0; c < G::WINDOW_COLS; c++) {
+					#pragma HLS UNROLL
+					window[k][c] = 0.0f;
+				}
+			}
 
-			for (i = -r; i <= r; ++i) {
-						#pragma HLS PIPELINE off
+			for (t = 0; t < vecs + G::WINDOW_HALO; t++) {
+				#pragma HLS PIPELINE II=1
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=G::MAX_VECS
 
-				for (j = -r; j <= r; ++j) {
-							#pragma HLS PIPELINE off
+				if (doRead && t < vecs) {
+					const IN_VEC v = frameIn[(rowIn - in_row0) * vecs + t];
+					for (p = 0; p < PIXELS_PER_CYCLE; p++) {
+						lineBuffer[writeRow][t * PIXELS_PER_CYCLE + p] = depth_pixel(v.data[p]);
+					}
+				}
 
-					unsigned int curPos_x = MAX(0u, MIN(x + i,size_x - 1));
-					unsigned int curPos_y = MAX(0u, MIN(y + j,size_y - 1));
+				if (!doCompute) {
+					continue;
+				}
 
-					const float curPix = in[curPos_x + curPos_y * size_x];
-					if (curPix > 0) {
-						const float mod = (curPix - center) * (curPix - center);
-						const float factor = gaussian[i + r]
-								*gaussian[j + r]
-								* expf(-mod / 0.02f);
-						t += factor * curPix;
-						sum += factor;
+				// Slide the window one vector to the left
+				const int loadVec = MIN(t, vecs - 1);
+				for (k = 0; k < G::WINDOW_SIZE; k++) {
+					for (c = 0; c < G::WINDOW_COLS - PIXELS_PER_CYCLE; c++) {
+						window[k][c] = window[k][c + PIXELS_PER_CYCLE];
+					}
+					for (p = 0; p < PIXELS_PER_CYCLE; p++) {
+						window[k][G::WINDOW_COLS - PIXELS_PER_CYCLE + p] =
+								lineBuffer[source[k]][loadVec * PIXELS_PER_CYCLE + p];
 					}
 				}
+
+				if (t < G::WINDOW_HALO) {
+					continue;
+				}
+
+				const int outVec = t - G::WINDOW_HALO;
+				pixel_vec result;
+				for (p = 0; p < PIXELS_PER_CYCLE; p++) {
+					const int x = outVec * PIXELS_PER_CYCLE + p;
+					const float center = window[MAX_R][G::WINDOW_HALO * PIXELS_PER_CYCLE + p];
+
+					float sum = 0.0f;
+					float acc = 0.0f;
+#ifdef FILTER_STATS
+					filter_stats* stats = stats_tile(f, x, y);
+					stats->pixels++;
+					stats->zero_pixels += center == 0;
+#endif
+
+					for (i = -MAX_R; i <= MAX_R; ++i) {
+						const int col = x + i;
+						const bool outside = col < 0 || col >= size_x;
+						for (j = -MAX_R; j <= MAX_R; ++j) {
+							if (i < -r || i > r || j < -r || j > r) {
+								continue;
+							}
+							const int k2 = j + MAX_R;
+							const float curPix = outside ? edge[k2]
+									: window[k2][G::WINDOW_HALO * PIXELS_PER_CYCLE + p + i];
+#ifdef FILTER_STATS
+							if (center != 0) {
+								stats->taps++;
+								stats->rejected_taps += curPix <= 0;
+								if (curPix > 0) {
+									stats_weight(stats, expf(-(curPix - center) * (curPix - center) / 0.02f));
+								}
+							}
+#endif
+							if (curPix > 0) {
+								const float mod = (curPix - center) * (curPix - center);
+								const float weight = ROM_WEIGHTS
+										? spatialRom[i < 0 ? -i : i][j < 0 ? -j : j]
+										: spatial[i + MAX_R] * spatial[j + MAX_R];
+								const float factor = weight * expf(-mod / 0.02f);
+								acc += factor * curPix;
+								sum += factor;
+							}
+						}
+					}
+					result.data[p] = (center == 0) ? 0.0f : acc / sum;
+				}
+				frameOut[(y - out_row0) * vecs + outVec] = result;
 			}
-			out[pos] = t / sum;
 		}
 	}
 }
 
-}
\ No newline at end of file
+/**
+ * Interface of every top function below, shared so that the
+ * instances stay register compatible with the host. The
+ * ROM instance has no gaussian port.
+ * */
+#define BILATERAL_KERNEL_INTERFACE \
+	_Pragma("HLS INTERFACE s_axilite port=return bundle=control") \
+	_Pragma("HLS INTERFACE m_axi port=out offset=slave bundle=gmem") \
+	_Pragma("HLS INTERFACE s_axilite port=out bundle=control") \
+	_Pragma("HLS INTERFACE m_axi port=in offset=slave bundle=gmem") \
+	_Pragma("HLS INTERFACE s_axilite port=in bundle=control") \
+	_Pragma("HLS INTERFACE s_axilite port=size_x bundle=control") \
+	_Pragma("HLS INTERFACE s_axilite port=size_y bundle=control") \
+	_Pragma("HLS INTERFACE s_axilite port=r bundle=control") \
+	_Pragma("HLS INTERFACE s_axilite port=frames bundle=control") \
+	_Pragma("HLS INTERFACE s_axilite port=frame_stride bundle=control") \
+	_Pragma("HLS INTERFACE s_axilite port=row_begin bundle=control") \
+	_Pragma("HLS INTERFACE s_axilite port=row_end bundle=control") \
+	_Pragma("HLS INTERFACE s_axilite port=in_row0 bundle=control") \
+	_Pragma("HLS INTERFACE s_axilite port=out_row0 bundle=control") \
+	_Pragma("HLS DATA_PACK variable=out") \
+	_Pragma("HLS DATA_PACK variable=in")
+
+#define BILATERAL_GAUSSIAN_INTERFACE \
+	_Pragma("HLS INTERFACE m_axi port=gaussian offset=slave bundle=gmem") \
+	_Pragma("HLS INTERFACE s_axilite port=gaussian bundle=control")
+
+/**
+ * Extern is a requirement for Vitis Unified Software Platform,
+ * when we use a .cpp (C++ source code) file.
+ * */
+extern "C" {
+
+/***********************************************************
+ * Function:  bilateralFilterKernel
+ * ---------------------------------------------------------
+ * Applies a vector filter on a SIZE_X x SIZE_Y input image.
+ *
+ *                           Apply
+ *    +--------------+     +--------+    +--------------+
+ *    |              |     |        |    |              |
+ *    | Input Image  +---->+ Filter +--->+ Output Image |
+ *    |              |     |        |    |              |
+ *    +--------------+     +--------+    +--------------+
+ *
+ *  out: The output image after the filter was applied.
+ *
+ *  in: The input image.
+ *
+ *  gaussian: A 5 element vector that holds the filter values.
+ *
+ *  frames, frame_stride: Batch of frames filtered in one launch,
+ *  frame_stride pixels apart in both in and out.
+ *
+ *  row_begin, row_end, in_row0, out_row0: Band of rows computed
+ *  by this launch and the frame rows at in[0] / out[0]. Use
+ *  0, size_y, 0, 0 for whole frames.
+ *
+ * Every top function below is one instance of
+ * bilateralFilterCore. Pick it with make KERNEL_NAME=<name>.
+ *************************************************************/
+// Generic kernel: r <= 2, width <= 1920.
+void bilateralFilterKernel(pixel_vec* out, const pixel_vec* in,const float* gaussian,int size_x,int size_y,int r,int frames,int frame_stride,
+		int row_begin,int row_end,int in_row0,int out_row0) {
+
+	BILATERAL_KERNEL_INTERFACE
+	BILATERAL_GAUSSIAN_INTERFACE
+
+	bilateralFilterCore<2, 1920, false>(out, in, gaussian, size_x, size_y, r, frames, frame_stride,
+			row_begin, row_end, in_row0, out_row0);
+}
+
+// Lab frames: r <= 2, width <= 320.
+void bilateralFilterKernelR2W320(pixel_vec* out, const pixel_vec* in,const float* gaussian,int size_x,int size_y,int r,int frames,int frame_stride,
+		int row_begin,int row_end,int in_row0,int out_row0) {
+
+	BILATERAL_KERNEL_INTERFACE
+	BILATERAL_GAUSSIAN_INTERFACE
+
+	bilateralFilterCore<2, 320, false>(out, in, gaussian, size_x, size_y, r, frames, frame_stride,
+			row_begin, row_end, in_row0, out_row0);
+}
+
+// VGA depth frames: r <= 2, width <= 640.
+void bilateralFilterKernelR2W640(pixel_vec* out, const pixel_vec* in,const float* gaussian,int size_x,int size_y,int r,int frames,int frame_stride,
+		int row_begin,int row_end,int in_row0,int out_row0) {
+
+	BILATERAL_KERNEL_INTERFACE
+	BILATERAL_GAUSSIAN_INTERFACE
+
+	bilateralFilterCore<2, 640, false>(out, in, gaussian, size_x, size_y, r, frames, frame_stride,
+			row_begin, row_end, in_row0, out_row0);
+}
+
+// VGA depth frames, wide smoothing: r <= 4, width <= 640.
+void bilateralFilterKernelR4W640(pixel_vec* out, const pixel_vec* in,const float* gaussian,int size_x,int size_y,int r,int frames,int frame_stride,
+		int row_begin,int row_end,int in_row0,int out_row0) {
+
+	BILATERAL_KERNEL_INTERFACE
+	BILATERAL_GAUSSIAN_INTERFACE
+
+	bilateralFilterCore<4, 640, false>(out, in, gaussian, size_x, size_y, r, frames, frame_stride,
+			row_begin, row_end, in_row0, out_row0);
+}
+
+// Generic kernel with the spatial weights in ROM: r <= 2, width <= 1920.
+void bilateralFilterKernelRom(pixel_vec* out, const pixel_vec* in,int size_x,int size_y,int r,int frames,int frame_stride,
+		int row_begin,int row_end,int in_row0,int out_row0) {
+
+	BILATERAL_KERNEL_INTERFACE
+
+	bilateralFilterCore<2, 1920, true>(out, in, NULL, size_x, size_y, r, frames, frame_stride,
+			row_begin, row_end, in_row0, out_row0);
+}
+
+// Generic kernel for uint16 depth frames (millimetres): r <= 2,
+// width <= 1920. in moves P uint16 pixels per beat, half the
+// traffic of the float kernels, and every lane converts its
+// pixel with one pipelined divider on the way into the line
+// buffers. out stays float.
+void bilateralFilterKernelU16(pixel_vec* out, const depth_vec* in,const float* gaussian,int size_x,int size_y,int r,int frames,int frame_stride,
+		int row_begin,int row_end,int in_row0,int out_row0) {
+
+	BILATERAL_KERNEL_INTERFACE
+	BILATERAL_GAUSSIAN_INTERFACE
+
+	bilateralFilterCore<2, 1920, false>(out, in, gaussian, size_x, size_y, r, frames, frame_stride,
+			row_begin, row_end, in_row0, out_row0);
+}
+
+}
@@ -0,0 +1,65 @@
+#ifndef _FILTER_HLS_H_
+#define _FILTER_HLS_H_
+
+/***********************************************************
+ * Definitions shared by the memory-mapped (filterHLS.cpp)
+ * and the streaming (filterStreamHLS.cpp) kernels.
+ * *********************************************************/
+
+#include <stdint.h>
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#define MAX(a,b) (((a)>(b))?(a):(b))
+
+#ifndef PIXELS_PER_CYCLE
+#define PIXELS_PER_CYCLE 1
+#endif
+
+/**
+ * P consecutive pixels of a row. Used as the m_axi data type,
+ * so that every bus beat carries P floats.
+ * */
+typedef struct {
+	float data[PIXELS_PER_CYCLE];
+} pixel_vec;
+
+/**
+ * P consecutive pixels of a uint16 depth frame, as the depth
+ * cameras deliver them: half the bus traffic of pixel_vec.
+ * */
+typedef struct {
+	uint16_t data[PIXELS_PER_CYCLE];
+} depth_vec;
+
+// Depth units per metre of uint16 frames (millimetres). Must
+// match DEPTH_UNITS of lab5-software/filterCommon.h.
+#define DEPTH_UNITS 1000.0f
+
+// Input pixel in metres, converted as it is read. The
+// division is exact to the float input files, which hold
+// millimetres / 1000 rounded to float.
+static inline float depth_pixel(float v) {
+	return v;
+}
+static inline float depth_pixel(uint16_t v) {
+	return v / DEPTH_UNITS;
+}
+
+/***********************************************************
+ * Spatial weights gaussian[a] * gaussian[b] for tap offsets
+ * |a|, |b| <= 4, with gaussian[d] = expf(-(d * d) / 32) as the
+ * host computes them. Kernels built with SPATIAL_ROM and the
+ * streaming kernel take their weights from here: the tap loops
+ * are fully unrolled, so every lookup folds into a constant
+ * multiplier and no filter vector is read over m_axi.
+ * *********************************************************/
+#define SPATIAL_ROM_RADIUS 4
+static const float spatialRom[SPATIAL_ROM_RADIUS + 1][SPATIAL_ROM_RADIUS + 1] = {
+	{1.0f, 0.969233215f, 0.882496893f, 0.754839599f, 0.606530666f},
+	{0.969233215f, 0.939413011f, 0.855345309f, 0.731615603f, 0.587869644f},
+	{0.882496893f, 0.855345309f, 0.778800786f, 0.666143596f, 0.535261452f},
+	{0.754839599f, 0.731615603f, 0.666143596f, 0.569782794f, 0.45783338f},
+	{0.606530666f, 0.587869644f, 0.535261452f, 0.45783338f, 0.36787945f},
+};
+
+#endif
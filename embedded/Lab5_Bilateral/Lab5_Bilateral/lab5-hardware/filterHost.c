@@ -1,23 +1,36 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include "time.h"
+#include "filterCommon.h" // Image size, input and golden files
+#include "filterTrace.h" // Timing, and the trace file named by FILTER_TRACE
+#include "filterPerf.h" // CPU performance counters, on with FILTER_PERF
+#include "filterStats.h" // Workload counters of the filter (make STATS=yes)
+
+#define BATCH 1 // Default number of frames filtered per kernel launch
+#define MAX_BANDS 16 // Largest number of row bands (one per compute unit)
+#define LAUNCHES 1 // Default number of kernel launches streamed through the pipeline
+#ifndef BUFFER_SETS
+#define BUFFER_SETS 3 // Input/output buffer pairs in flight (make SETS=...)
+#endif
+#ifndef PIXELS_PER_CYCLE
+#define PIXELS_PER_CYCLE 1 // Must match the kernel build (make PPC=...)
+#endif
+#ifndef KERNEL_NAME
+#define KERNEL_NAME "bilateralFilterKernel" // Kernel instance in the xclbin (make KERNEL_NAME=...)
+#endif
+// SPATIAL_ROM (make ROM=yes): the kernel holds the filter vector in ROM,
+// so the gaussian buffer is neither created nor migrated.
+// CPU_COSCHEDULE (make CPU=yes): the ARM cores filter the bottom rows of
+// every frame with the OpenMP kernel of lab5-software while the FPGA
+// filters the top rows.
+// DEPTH_U16 (make DEPTH=u16): the frames are uint16 depth, in millimetres,
+// as depth cameras deliver them. The kernel converts them to metres as
+// it reads them, so they move at half the bytes of float frames.
+#define CPU_MIN_ROWS 8 // Fewest rows given to either engine when co-scheduling
+#define BAND_SLACK_ROWS 16 // Rows a band input sub-buffer reaches above the halo when remade
 
-#define SIZE_X 320 // Input image Width
-#define SIZE_Y 240 // Input image Height
-#define FILTER_SIZE 5 // Filter size
-#define FILTER_RADIUS 2 // Filter radius
-
-/**** Timing Macros *****/
-struct timespec tick_clockData;
-struct timespec tock_clockData;
-
-#define TICK()    { clock_gettime(CLOCK_MONOTONIC, &tick_clockData);}
-#define TOCK(str) { clock_gettime(CLOCK_MONOTONIC, &tock_clockData);\
-                    printf("%s\t%f milliseconds\n",str,\
-                    (((double) tock_clockData.tv_sec + tock_clockData.tv_nsec / 1000000000.0) - \
-                    ((double) tick_clockData.tv_sec + tick_clockData.tv_nsec / 1000000000.0))\
-                    * 1000);}
 /**** OpenCL necessary Defines ****/
 #define CL_HPP_CL_1_2_DEFAULT_BUILD
 #define CL_HPP_TARGET_OPENCL_VERSION 120
@@ -25,127 +38,283 @@ struct timespec tock_clockData;
 #define CL_HPP_ENABLE_PROGRAM_CONSTRUCTION_FROM_ARRAY_COMPATIBILITY 1
 #define CL_USE_DEPRECATED_OPENCL_1_2_APIS
 #include <CL/cl2.hpp>
+#include <CL/cl_ext_xilinx.h>
+#include "filterProfile.h"
+#include "filterBuffers.h"
+#include "filterSession.h"
+#ifdef CPU_COSCHEDULE
+#include <omp.h>
+#include "filterOmp.h"
+#endif
 
 /**** OpenCL API variables ****/
 cl_int err;
 cl_uint check_status = 0;
 
-cl_platform_id platform_id;
-cl_platform_id platforms[16];
-cl_uint platform_count;
-cl_uint platform_found = 0;
-char cl_platform_vendor[1001];
-
-cl_uint num_devices;
-cl_uint device_found = 0;
-cl_device_id devices[16];
-char cl_device_name[1001];
-cl_device_id device_id;
-
-cl_context context;
+// Device, queue, program and buffer pool of the run
+filter_session session;
 cl_command_queue q;
-cl_program program;
 
-cl_kernel bilateralFilterKernel; // Handler for hardware kernel
-// Alternative for 2 compute units
-// cl_kernel bilateralFilterKernel_1;
-// cl_kernel bilateralFilterKernel_2;
-
-cl_mem pt_in[2];
-cl_mem pt_out[1];
+// One handler per buffer set and row band. XRT starts every
+// enqueued handler on a free compute unit, so all bands run
+// concurrently. Handlers live in the session, at index
+// s * MAX_BANDS + b. Static, as the mock build links the
+// kernel function of the same name into this executable.
+static cl_kernel bilateralFilterKernel[BUFFER_SETS][MAX_BANDS];
+
+// Events of the launch in flight on every buffer set
+cl_event gaussian_event;
+cl_event h2d_events[BUFFER_SETS];
+cl_event kernel_events[BUFFER_SETS][MAX_BANDS];
+cl_uint kernel_count[BUFFER_SETS];
+cl_event d2h_events[BUFFER_SETS];
 cl_int status;
 
 /*** Variables used as kernel arguments ***/
-cl_mem input_buffer;
-cl_mem output_buffer;
+// Taken from the session pool by every launch, returned once consumed
+cl_mem input_buffer[BUFFER_SETS];
+cl_mem output_buffer[BUFFER_SETS];
 cl_mem gaussian_buffer;
 
-// Input Array
-float *input;
-// Output Array
-float *output;
+/**
+ * Input sub-buffer of one band of rows on one buffer set. It
+ * runs from the top of the band's halo, rounded down to a
+ * valid sub-buffer origin, to the end of the frame, so the
+ * band may move down and grow without a new one. The
+ * output is not split: the bands of a batch interleave in
+ * it, so output sub-buffers would overlap while written.
+ * */
+typedef struct {
+    cl_mem input_parent;
+    cl_mem input;
+    int in_row0;
+} band_region;
+
+band_region band_regions[BUFFER_SETS][MAX_BANDS];
+// Band rows start at multiples of band_quantum
+int band_quantum = 1;
+int band_buffers_created = 0;
+
+// Pixels of the input frames
+#ifdef DEPTH_U16
+typedef uint16_t input_pixel;
+#else
+typedef float input_pixel;
+#endif
+
+// Input frame, as read from input.bin
+float *frame_data;
+// Input Arrays, page aligned host memory used by the input buffers
+input_pixel *input[BUFFER_SETS];
+// Output Arrays, page aligned host memory used by the output buffers
+float *output[BUFFER_SETS];
 // Filter Vector
 float *gaussian;
 
+// Rows of every frame filtered by the FPGA, the CPU takes the rest.
+// Rows per millisecond of both engines, smoothed over launches.
+int fpga_rows = SIZE_Y;
+double fpga_rate, cpu_rate;
+#ifdef CPU_COSCHEDULE
+// Filter vector of the CPU engine
+float cpu_gaussian[FILTER_SIZE];
+// CPU output of the launch on every set, stitched into output once
+// the FPGA rows arrived
+float *cpu_output[BUFFER_SETS];
+// First CPU row and CPU time of the launch on every set
+int cpu_row_begin[BUFFER_SETS];
+double cpu_ms[BUFFER_SETS];
+#endif
+
+/**
+ * Device timeline of one launch, in nanoseconds of the
+ * OpenCL profiling clock. The kernel stage spans from the
+ * first band start to the last band end.
+ * */
+typedef struct {
+    cl_ulong h2d_start, h2d_end;
+    cl_ulong kernel_start, kernel_end;
+    cl_ulong d2h_start, d2h_end;
+} launch_timeline;
+
 
 /***********************************************************
- * Function:  load_file_to_memory
- * ------------------------------
- * Loads the hardware binary file (*.xclbin) into memory.
+ * Function:  update_band
+ * ---------------------------------------------------------
+ * Points band at rows starting at row_begin of the frames
+ * in input_buffer. Its sub-buffer is kept while it holds
+ * the halo, so a co-scheduled split that moves every launch
+ * only changes the kernel arguments. A band that starts
+ * above it gets a new one, BAND_SLACK_ROWS higher, so that
+ * a split jittering by a few rows settles on it. A halo
+ * crossing the top of the frame reads the last row as
+ * border, so that band gets the whole input frame.
  * *********************************************************/
-cl_uint load_file_to_memory(const char *filename, char **result)
-{
-    cl_uint size = 0;
-    FILE *f = fopen(filename, "rb");
-    if (f == NULL) {
-        *result = NULL;
-        return -1; // -1 means file opening fail
-    }
-    fseek(f, 0, SEEK_END);
-    size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    *result = (char *)malloc(size+1);
-    if (size != fread(*result, sizeof(char), size, f)) {
-        free(*result);
-        return -2; // -2 means file reading fail
-    }
-    fclose(f);
-    (*result)[size] = 0;
-    return size;
+cl_int update_band(band_region *band, cl_mem input_buffer, int frames, int row_begin){
+    size_t in_row_bytes = sizeof(input_pixel) * SIZE_X;
+    int halo = row_begin - FILTER_RADIUS;
+    cl_int err;
+
+    if (band->input && band->input_parent == input_buffer &&
+        (band->in_row0 == 0 || (halo >= 0 && band->in_row0 <= halo))) {
+        return CL_SUCCESS;
+    }
+    if (band->input) {
+        clReleaseMemObject(band->input);
+        halo -= BAND_SLACK_ROWS;
+    }
+
+    band->in_row0 = halo < 0 ? 0 : halo / band_quantum * band_quantum;
+    band->input = band_buffer(input_buffer, CL_MEM_READ_ONLY, in_row_bytes, in_row_bytes * SIZE_Y, frames,
+                              band->in_row0, SIZE_Y, &err);
+    if (err != CL_SUCCESS) {
+        band->input = NULL;
+        return err;
+    }
+    band->input_parent = input_buffer;
+    band_buffers_created++;
+    return CL_SUCCESS;
 }
 
 
 /***********************************************************
- * Function:  read_input
+ * Function:  produce_input
+ * ---------------------------------------------------------
+ * Stands in for the frame source (e.g. a camera): copies the
+ * input frame to every frame slot of a mapped input buffer,
+ * packed back to back. uint16 frames get the input frame in
+ * depth units.
+ * *********************************************************/
+void produce_input(input_pixel *in, int frames){
+    int f;
+#ifdef DEPTH_U16
+    int i;
+
+    for (i = 0; i < SIZE_X * SIZE_Y; i++) {
+        in[i] = depth_from_float(frame_data[i]);
+    }
+    for (f = 1; f < frames; f++) {
+        memcpy(in + f * SIZE_X * SIZE_Y, in, sizeof(input_pixel) * SIZE_X * SIZE_Y);
+    }
+#else
+    for (f = 0; f < frames; f++) {
+        memcpy(in + f * SIZE_X * SIZE_Y, frame_data, sizeof(float) * SIZE_X * SIZE_Y);
+    }
+#endif
+}
+
+/***********************************************************
+ * Function:  event_time
  * ---------------------------------------------------------
- * Reads the input.bin file, and loads it to input array.
+ * Returns a profiling timestamp (CL_PROFILING_COMMAND_*)
+ * of a completed event, or 0 if it is not available.
  * *********************************************************/
-void read_input(){
-    FILE *fptr;
+cl_ulong event_time(cl_event event, cl_profiling_info param){
+    cl_ulong t = 0;
 
-    /**** Load Input image ****/
-    if ((fptr = fopen("input.bin","r")) == NULL){
-        printf("Error! opening file");
-        exit(1);
+    if (clGetEventProfilingInfo(event, param, sizeof(cl_ulong), &t, NULL) != CL_SUCCESS) {
+        return 0;
     }
-    fread(input, sizeof(float) * SIZE_X * SIZE_Y, 1, fptr);
-    fclose(fptr);
+    return t;
 }
 
 /***********************************************************
- * Function:  compare
+ * Function:  record_timeline
  * ---------------------------------------------------------
- * Reads the output.bin file, that contains the golden output
- * values. Then it compares it with the filter output array by
- * calculating the Mean Error Square (MSE). The perfect solution
- * must have an MSE value of 0. A greater value corresponds to
- * a worse solution.
+ * Collects the device timeline of the launch that just
+ * completed on buffer set s, and adds its events to the
+ * profile. prev is the timeline of the previous launch, or
+ * NULL for the first one.
  * *********************************************************/
-void compare(){
-    FILE *fptr;
-    int y,x;
-    double diff;
-    double mse=-0.068993; // A calculated constant - DO NOT CHANGE IT.
-
-    // Open output file and load it to outputGolden
-    if ((fptr = fopen("goldenOutput.bin","r")) == NULL){
-            printf("Error! opening file");
-            exit(1);
-    }
-    float *goldenOutput = (float*) malloc(sizeof(float) * SIZE_X * SIZE_Y);
-    fread(goldenOutput, sizeof(float) * SIZE_X * SIZE_Y, 1, fptr);
-    fclose(fptr);
-
-    // Calculate MSR
-    for ( x = 0; x < SIZE_X; x++) {
-        for (y = 0; y < SIZE_Y; y++){
-            diff = output[x + y * SIZE_X] - goldenOutput[x + y *SIZE_X];
-            mse += pow(fabs(diff),2.0);
+void record_timeline(launch_timeline *t, const launch_timeline *prev, int s){
+    cl_uint k;
+    cl_ulong start, end;
+
+    t->h2d_start = event_time(h2d_events[s], CL_PROFILING_COMMAND_START);
+    t->h2d_end = event_time(h2d_events[s], CL_PROFILING_COMMAND_END);
+    t->kernel_start = event_time(kernel_events[s][0], CL_PROFILING_COMMAND_START);
+    t->kernel_end = event_time(kernel_events[s][0], CL_PROFILING_COMMAND_END);
+    for (k = 1; k < kernel_count[s]; k++) {
+        start = event_time(kernel_events[s][k], CL_PROFILING_COMMAND_START);
+        end = event_time(kernel_events[s][k], CL_PROFILING_COMMAND_END);
+        if (start < t->kernel_start) {
+            t->kernel_start = start;
+        }
+        if (end > t->kernel_end) {
+            t->kernel_end = end;
         }
     }
-    printf("MSE : %.6f\n", mse / (double) (SIZE_X*SIZE_Y));
+    t->d2h_start = event_time(d2h_events[s], CL_PROFILING_COMMAND_START);
+    t->d2h_end = event_time(d2h_events[s], CL_PROFILING_COMMAND_END);
 
-    free(goldenOutput);
+    profile_event(PROFILE_H2D, h2d_events[s]);
+    for (k = 0; k < kernel_count[s]; k++) {
+        profile_event(PROFILE_KERNEL, kernel_events[s][k]);
+    }
+    profile_event(PROFILE_D2H, d2h_events[s]);
+    if (prev != NULL) {
+        profile_sample(PROFILE_GAP, t->kernel_start > prev->kernel_end ?
+                       (t->kernel_start - prev->kernel_end) / 1000.0 : 0.0);
+    }
+}
+
+/***********************************************************
+ * Function:  print_timelines
+ * ---------------------------------------------------------
+ * Prints the start and end of every stage of every launch,
+ * in milliseconds since the first input migration, and
+ * the busy time of every stage against the wall time. When
+ * the pipeline overlaps transfers and compute, the stage
+ * times add up to more than the wall time.
+ * *********************************************************/
+void print_timelines(const launch_timeline *t, int launches){
+    cl_ulong t0 = t[0].h2d_start, t1 = 0;
+    double h2d = 0, kernel = 0, d2h = 0, wall;
+    int n;
+
+    printf("timeline (ms):\tlaunch\tH2D\t\tkernel\t\tD2H\n");
+    for (n = 0; n < launches; n++) {
+        printf("\t\t%d\t%.3f-%.3f\t%.3f-%.3f\t%.3f-%.3f\n", n,
+               (t[n].h2d_start - t0) / 1e6, (t[n].h2d_end - t0) / 1e6,
+               (t[n].kernel_start - t0) / 1e6, (t[n].kernel_end - t0) / 1e6,
+               (t[n].d2h_start - t0) / 1e6, (t[n].d2h_end - t0) / 1e6);
+        h2d += (t[n].h2d_end - t[n].h2d_start) / 1e6;
+        kernel += (t[n].kernel_end - t[n].kernel_start) / 1e6;
+        d2h += (t[n].d2h_end - t[n].d2h_start) / 1e6;
+        if (t[n].d2h_end > t1) {
+            t1 = t[n].d2h_end;
+        }
+    }
+    wall = (t1 - t0) / 1e6;
+    printf("busy (ms):\tH2D %.3f\tkernel %.3f\tD2H %.3f\twall %.3f\toverlapped %.3f\n",
+           h2d, kernel, d2h, wall, h2d + kernel + d2h - wall);
+}
+
+/***********************************************************
+ * Function:  balance_split
+ * ---------------------------------------------------------
+ * Returns the FPGA rows for the next launches, given the
+ * rows and time of both engines on the last one. Every
+ * engine gets rows in proportion to its throughput, so that
+ * both finish a frame at the same time and their throughputs
+ * add up. The rates are smoothed to not chase noise.
+ *
+ * fpga_ms is the whole FPGA side of the launch, migrations
+ * included, as the CPU time is its whole side: from the
+ * input migration, or from the end of the previous launch
+ * when the buffer sets overlap them, to the end of the
+ * output migration. The kernel time alone would lean the
+ * split towards the FPGA whenever the transfers are not
+ * hidden.
+ * *********************************************************/
+int balance_split(int fpga_done, double fpga_ms, int cpu_done, double cpu_ms){
+    double f = fpga_done / fpga_ms, c = cpu_done / cpu_ms;
+    int rows;
+
+    fpga_rate = fpga_rate > 0 ? 0.5 * (fpga_rate + f) : f;
+    cpu_rate = cpu_rate > 0 ? 0.5 * (cpu_rate + c) : c;
+    rows = (int) (SIZE_Y * fpga_rate / (fpga_rate + cpu_rate) + 0.5);
+    return MAX(CPU_MIN_ROWS, MIN(rows, SIZE_Y - CPU_MIN_ROWS));
 }
 
 /***********************************************************
@@ -155,199 +324,165 @@ void compare(){
  * *********************************************************/
 int main(int argc, char *argv[]){
     // Input and output array size
-    size_t buffer_size = sizeof(float) * SIZE_X * SIZE_Y;
-	size_t n0,len;
-    cl_uint iplat, n_i0;
-    char *hw_binary_path,*kernelbinary;
-    char buffer[2048];
-    int argcounter,x,i;
+    size_t frame_size = sizeof(float) * SIZE_X * SIZE_Y;
+    size_t buffer_size, input_size;
+    char *hw_binary_path;
+    int argcounter;
+#ifdef CPU_COSCHEDULE
+    int i;
+    cl_ulong fpga_start;
+#endif
+    cl_uint k;
     // Variables that will be used as kernel arguments
     int r;
     int size_x;
     int size_y;
+    int frames = BATCH;
+    int frame_stride;
+    int row_begin[MAX_BANDS], row_end[MAX_BANDS];
+    int row_arg = 0;
+    int out_row0 = 0; // bands write the whole output buffer
+    int bands = 0, band_rows, b;
+    int launches = LAUNCHES, sets, n, s;
+    cl_uint compute_units = 1;
+    cl_uint n_in;
+    cl_mem pt_in[1], pt_out[1];
+    launch_timeline *timeline;
 
     if ( argc < 2) {
-        printf("1 Argument needed : <*.xclbin path>");
+        printf("1 Argument needed : <*.xclbin path> [frames per launch] [bands] [launches]");
         return EXIT_FAILURE;
     }
     hw_binary_path = argv[1];
-
-    /**********************************************
-	 *
-	 * 			Xilinx OpenCL Initialization
-	 *
-     * We must follow specific steps to get the necessary
-     * information and handlers, in order to be able
-     * to use the available accelerator device (FPGA).
-     * After every step, we always check for any errors
-     * that might have occured. In case of error, the
-     * program aborts and exits immediately.
-	 * *********************************************/
-
-
-
-    /**************************************************
-	* Step 1:
-    * Get available OpenCL platforms and devices.
-    * In our case, is a Xilinx FPGA device.
-    * If the underlying platform has other accelerators
-    * available, we could use them too (e.g. GPU, CPU).
-	**************************************************/
-	err = clGetPlatformIDs(16, platforms, &platform_count);
-    if (err != CL_SUCCESS) {
-        printf("Error: Failed to find an OpenCL platform!\n");
+    if (argc > 2) {
+        frames = atoi(argv[2]);
+    }
+    if (frames < 1) {
+        printf("Error: frames per launch must be positive\n");
         return EXIT_FAILURE;
     }
-
-    printf("INFO: Found %d platforms\n", platform_count);
-
-	for (iplat=0; iplat<platform_count; iplat++) {
-			err = clGetPlatformInfo(platforms[iplat], CL_PLATFORM_VENDOR, 1000, (void *)cl_platform_vendor,NULL);
-        if (err != CL_SUCCESS) {
-            printf("Error: clGetPlatformInfo(CL_PLATFORM_VENDOR) failed!\n");
-            return EXIT_FAILURE;
-        }
-        /*** We are interested for Xilinx devices ***/
-        if (strcmp(cl_platform_vendor, "Xilinx") == 0) {
-            printf("INFO: Selected platform %d from %s\n", iplat, cl_platform_vendor);
-            platform_id = platforms[iplat];
-            platform_found = 1; // There is only one available.
-        }
+    // 0 bands means one band per compute unit of the xclbin
+    if (argc > 3) {
+        bands = atoi(argv[3]);
     }
-    if (!platform_found) {
-        printf("ERROR: Platform Xilinx not found. Exit.\n");
+    if (bands < 0 || bands > MAX_BANDS) {
+        printf("Error: bands must be between 0 and %d\n", MAX_BANDS);
         return EXIT_FAILURE;
     }
-	err = clGetDeviceIDs(platform_id, CL_DEVICE_TYPE_ACCELERATOR, 16, devices, &num_devices);
-    printf("INFO: Found %d devices\n", num_devices);
-    if (err != CL_SUCCESS) {
-        printf("ERROR: Failed to create a device group!\n");
-        return EXIT_FAILURE;
+    if (argc > 4) {
+        launches = atoi(argv[4]);
     }
-
-	device_id = devices[0]; // we have only one device
-
-	// ---------------------------------------------------------------
-	// Step 2 : Create Context
-	// ---------------------------------------------------------------
-	context = clCreateContext(0,1,&device_id,NULL,NULL,&err);
-	if (!context) {
-        printf("Error: Failed to create a compute context!\n");
+    if (launches < 1) {
+        printf("Error: launches must be positive\n");
         return EXIT_FAILURE;
     }
-
-	// ---------------------------------------------------------------
-	// Step 3 : Create Command Queue
-	// ---------------------------------------------------------------
-	q = clCreateCommandQueue(context, device_id, CL_QUEUE_PROFILING_ENABLE, &err);
-    // ---------------------------------------------------------------
-	// Step 3 for 2 compute units: Create Command Queue
-	// ---------------------------------------------------------------
-    // q = clCreateCommandQueue(context, device_id, CL_QUEUE_PROFILING_ENABLE | CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, &err);
-	if (!q) {
-        printf("Error: Failed to create a command q! Error code: %i\n",err);
+    // No more buffer sets than launches in flight
+    sets = MIN(launches, BUFFER_SETS);
+    // All frames of a batch share one buffer, packed back to back
+    buffer_size = frame_size * frames;
+    input_size = sizeof(input_pixel) * SIZE_X * SIZE_Y * frames;
+
+    // The kernel moves PIXELS_PER_CYCLE pixels per bus beat
+    if (SIZE_X % PIXELS_PER_CYCLE != 0) {
+        printf("Error: image width %d is not a multiple of %d pixels per cycle\n", SIZE_X, PIXELS_PER_CYCLE);
         return EXIT_FAILURE;
     }
 
-	// ---------------------------------------------------------------
-	// Step 4 : Load Hardware Binary File (*.xclbin) from disk
-	// ---------------------------------------------------------------
-    n_i0 = load_file_to_memory(hw_binary_path, (char **) &kernelbinary);
-    if (n_i0 < 0) {
-            printf("failed to load kernel from xclbin: %s\n", hw_binary_path);
-            exit(EXIT_FAILURE);
-        }
-    n0 = n_i0;
-
-    // ---------------------------------------------------------------
-	// Step 5 : Create program using the loaded hardware binary file
-	// ---------------------------------------------------------------
-    program = clCreateProgramWithBinary(context, 1, &device_id, &n0,
-                                        (const unsigned char **) &kernelbinary, &status, &err);
-	free(kernelbinary);
-
-    if ((!program) || (err!=CL_SUCCESS)) {
-        printf("Error: Failed to create compute program from binary %d!\n", err);
-        exit(EXIT_FAILURE);
+    /**********************************************
+	 *
+	 * 			Xilinx OpenCL Initialization
+	 *
+     * The session finds the accelerator device, creates an
+     * out of order queue with profiling, loads the xclbin
+     * and builds the program. It is opened once and then
+     * serves every launch: a launch only takes buffers from
+     * its pool, sets kernel arguments and enqueues commands.
+	 * *********************************************/
+    if (session_open(&session, hw_binary_path, KERNEL_NAME) != 0) {
+        return EXIT_FAILURE;
     }
+    q = session.hardware.mQueue;
 
 	// -------------------------------------------------------------
-	//  Step 6 for 1 Compute Unit: Create Kernels - the actual handler of the kernel that
-    //           we will be using. We first create a program, and then
-    //           obtain the kernel handler from the program.
+	//  Create Kernels - one handler for each buffer set and row band.
+    //  The number of bands follows the compute units that the
+    //  xclbin contains (make CUS=N), unless given.
 	// -------------------------------------------------------------
-	err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
-	if (err != CL_SUCCESS) {
-        printf("Error: Failed to build program executable!\n");
-        clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, &len);
-        printf("%s\n", buffer);
-        exit(EXIT_FAILURE);
-    }
-	bilateralFilterKernel = clCreateKernel(program, "bilateralFilterKernel", &err);
-    if (!bilateralFilterKernel || err != CL_SUCCESS) {
-        printf("Error: Failed to create compute bilateralFilterKernel!\n");
-		exit(EXIT_FAILURE);
-    }
-    //// -------------------------------------------------------------
-	//  Step 6 for 2 Compute Units : Create Kernels - one handler for each
-    //           instance of the kernel that we will be using. The program
-    //           is the same as the step with 1 compute unit.
-	// -------------------------------------------------------------
-    // bilateralFilterKernel_1 = clCreateKernel(program, "bilateralFilterKernel:{bilateralFilterKernelInstance_1}", &err);
-    // if (!bilateralFilterKernel_1 || err != CL_SUCCESS) {
-    //     printf("Error: Failed to create compute krnl_bilateralFilterKernel_1!\n");
-	// 	exit(EXIT_FAILURE);
-    // }
-	// err = 0;
-	// bilateralFilterKernel_2 = clCreateKernel(program, "bilateralFilterKernel:{bilateralFilterKernelInstance_2}", &err);
-	// if (! bilateralFilterKernel_2 || err != CL_SUCCESS) {
-    //     printf("Error: Failed to create compute bilateralFilterKernel_2!\n");
-	// 	exit(EXIT_FAILURE);
-    // }
+	bilateralFilterKernel[0][0] = session_kernel(&session, 0);
+    err = clGetKernelInfo(bilateralFilterKernel[0][0], CL_KERNEL_COMPUTE_UNIT_COUNT, sizeof(cl_uint), &compute_units, NULL);
+    if (err != CL_SUCCESS) {
+        compute_units = 1;
+    }
+    if (bands == 0) {
+        bands = MIN(compute_units, MAX_BANDS);
+    }
+    printf("INFO: %d compute units, %d bands, %d buffer sets\n", compute_units, bands, sets);
+#ifdef CPU_COSCHEDULE
+    // Start with a quarter of the rows on the CPU, then balance
+    fpga_rows = SIZE_Y - SIZE_Y / 4;
+    printf("INFO: CPU co-scheduling, %d OpenMP threads\n", omp_get_max_threads());
+#endif
+    for (s = 0; s < sets; s++) {
+        for (b = 0; b < bands; b++) {
+            bilateralFilterKernel[s][b] = session_kernel(&session, s * MAX_BANDS + b);
+            if (!bilateralFilterKernel[s][b]) {
+                printf("Error: Failed to create compute bilateralFilterKernel %d!\n", b);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
 
 
     // -------------------------------------------------------------------------
-    // Step 7 : Create buffers.
-    // We do not need to allocate separate memory space (malloc), because
-    // on a MPSoC system (e.g. ZCU102 board), we map the memory space that is
-    // allocated at clCreateBuffer, to a usable memory space for our
-    // host application. We also do not need to use free for any reason.
+    // Create buffers.
+    // The frames live in page aligned host memory that the buffers use
+    // in place (CL_MEM_USE_HOST_PTR), so on a MPSoC system (e.g. ZCU102
+    // board) migrations only maintain the caches and never copy. Their
+    // buffers come from the session pool at every launch. The small
+    // filter vector is allocated by the runtime and mapped.
     // See Xilinx UG1393 for detailed information.
     // ------------------------------------------------------------------------
-    /*** Input image array buffer ***/
-    input_buffer = clCreateBuffer(context,  CL_MEM_READ_ONLY,  buffer_size, NULL, &err);
-    if (err != CL_SUCCESS) {
-     printf("Return code for clCreateBuffer - input_buffer: %d",err);
+    /*** Input and output image arrays, one pair per set ***/
+    for (s = 0; s < sets; s++) {
+        input[s] = (input_pixel *) frame_alloc(input_size);
+        output[s] = (float *) frame_alloc(buffer_size);
     }
-	input = (float *)clEnqueueMapBuffer(q,input_buffer,CL_TRUE,CL_MAP_WRITE,0,buffer_size,0,NULL,NULL,&err);
-
-    /*** Output image array buffer ***/
-    output_buffer = clCreateBuffer(context,  CL_MEM_WRITE_ONLY,  buffer_size, NULL, &err);
-    if (err != CL_SUCCESS) {
-     printf("Return code for clCreateBuffer - output_buffer: %d",err);
-    }
-	output = (float *)clEnqueueMapBuffer(q,output_buffer,CL_TRUE,CL_MAP_READ,0,buffer_size,0,NULL,NULL,&err);
 
+#ifndef SPATIAL_ROM
     /*** Filter vector buffer ***/
-    gaussian_buffer = clCreateBuffer(context,  CL_MEM_READ_ONLY,  FILTER_SIZE*sizeof(float), NULL, &err);
+    gaussian_buffer = session_buffer(&session, CL_MEM_READ_ONLY, FILTER_SIZE*sizeof(float), NULL, &err);
     if (err != CL_SUCCESS) {
      printf("Return code for clCreateBuffer - output_buffer: %d",err);
     }
 	gaussian = (float *)clEnqueueMapBuffer(q,gaussian_buffer,CL_TRUE,CL_MAP_WRITE,0,FILTER_SIZE*sizeof(float),0,NULL,NULL,&err);
+#endif
 
     /****
      * Data initialization
      * **************************/
-    TICK();
+    trace_start(getenv("FILTER_TRACE"));
+    perf_start();
+#ifdef FILTER_STATS
+    stats_start(SIZE_X, SIZE_Y);
+#endif
+    trace_begin("load");
+    perf_begin(PERF_LOAD);
     // Load input data to memory
-    read_input();
-
-    /**** Create filter vector using a suitable mathematical expression *****/
-    for (i = 0; i < FILTER_SIZE; i++) {
-		x = i - 2;
-		gaussian[i] = expf(-(x * x) / (32.0f));
-	}
-    TOCK("load_time:");
+    frame_data = (float *) malloc(frame_size);
+    timeline = (launch_timeline *) calloc(launches, sizeof(launch_timeline));
+    read_input(frame_data);
+
+#ifndef SPATIAL_ROM
+    make_gaussian(gaussian);
+#endif
+#ifdef CPU_COSCHEDULE
+    make_gaussian(cpu_gaussian);
+    for (s = 0; s < sets; s++) {
+        cpu_output[s] = (float *) malloc(buffer_size);
+    }
+#endif
+    perf_end(PERF_LOAD, (long) SIZE_X * SIZE_Y);
+    printf("load_time:\t%f milliseconds\n", trace_end());
 
     /*****
      * Kernel execution.
@@ -355,63 +490,222 @@ int main(int argc, char *argv[]){
      * **************************/
 
     /*****
-     * In order to use multiple compute units,
-     * consider what arguments earch kernel needs,
-     * and how you must split the input and output
-     * arrays.
+     * Multiple compute units: the frame is split in bands of
+     * rows, one per kernel handler. Every band reads its own
+     * rows plus r halo rows above and below from a sub-buffer
+     * of the input buffer that starts at its halo, sharing the
+     * allocation and the migrations of the frame buffer (see
+     * update_band). Every band writes only
+     * its own rows of the whole output buffer, so the bands
+     * merge in place: with several frames per launch the
+     * bands interleave, and OpenCL leaves concurrent writes
+     * to overlapping sub-buffers undefined.
      * ******************************************/
-    TICK();
+    band_quantum = band_row_quantum(session.hardware.mDevice, sizeof(input_pixel) * SIZE_X);
 
-    // Set HW Kernel arguments
+    // Set HW Kernel arguments, once for every buffer set. The
+    // buffers and rows are set per launch.
     r = FILTER_RADIUS;
     size_x = SIZE_X;
     size_y = SIZE_Y;
-    argcounter = 0;
-    err = 0;
-	err |= clSetKernelArg(bilateralFilterKernel,argcounter++, sizeof(cl_mem), &output_buffer);
-	err |= clSetKernelArg(bilateralFilterKernel,argcounter++, sizeof(cl_mem), &input_buffer);
-	err |= clSetKernelArg(bilateralFilterKernel,argcounter++, sizeof(cl_mem), &gaussian_buffer);
-   	err |= clSetKernelArg(bilateralFilterKernel,argcounter++, sizeof(int), &size_x);
-	err |= clSetKernelArg(bilateralFilterKernel,argcounter++, sizeof(int), &size_y);
-    err |= clSetKernelArg(bilateralFilterKernel,argcounter++, sizeof(int), &r);
-    if (err != CL_SUCCESS) {
-		printf("Error: Failed to set bilateralFilterKernel arguments! %d\n", err);
- 	}
+    frame_stride = SIZE_X * SIZE_Y;
+    for (s = 0; s < sets; s++) {
+        for (b = 0; b < bands; b++) {
+            argcounter = 0;
+            err = 0;
+            argcounter += 2; // output and input buffers
+#ifndef SPATIAL_ROM
+            err |= clSetKernelArg(bilateralFilterKernel[s][b],argcounter++, sizeof(cl_mem), &gaussian_buffer);
+#endif
+            err |= clSetKernelArg(bilateralFilterKernel[s][b],argcounter++, sizeof(int), &size_x);
+            err |= clSetKernelArg(bilateralFilterKernel[s][b],argcounter++, sizeof(int), &size_y);
+            err |= clSetKernelArg(bilateralFilterKernel[s][b],argcounter++, sizeof(int), &r);
+            err |= clSetKernelArg(bilateralFilterKernel[s][b],argcounter++, sizeof(int), &frames);
+            err |= clSetKernelArg(bilateralFilterKernel[s][b],argcounter++, sizeof(int), &frame_stride);
+            // row_begin, row_end, in_row0 and out_row0, set per launch
+            row_arg = argcounter;
+            if (err != CL_SUCCESS) {
+                printf("Error: Failed to set bilateralFilterKernel arguments! %d\n", err);
+            }
+        }
+    }
 
-    // Enqueue input memory objects migration - Host -> Device
-    pt_in[0] = input_buffer;
-    pt_in[1] = gaussian_buffer;
-    pt_out[0] = output_buffer;
+    trace_begin("filter");
+    perf_begin(PERF_FILTER);
 
-    err = clEnqueueMigrateMemObjects(q,(cl_uint)2, pt_in, 0 ,0,NULL, NULL);
+#ifndef SPATIAL_ROM
+    // The filter vector is migrated once, every launch waits for it
+    err = clEnqueueMigrateMemObjects(q,1, &gaussian_buffer, 0 ,0,NULL, &gaussian_event);
     if (err) {
         printf("Error: Failed to migrate memobjects to device! %d\n", err);
         return EXIT_FAILURE;
     }
+#endif
 
-    // Start kernel execution
-	err = clEnqueueTask(q, bilateralFilterKernel, 0, NULL, NULL);
-    if (err) {
-        printf("Error: Failed to execute kernel! %d\n", err);
-        return EXIT_FAILURE;
-    }
+    /*****
+     * Frame pipeline. Launch n uses buffer set n % sets, so with
+     * 2 or 3 sets the out of order queue can migrate the input
+     * of launch n+1 and the output of launch n-1 while launch n
+     * computes. Before a set is reused, the host waits for its
+     * output migration, consumes the output and produces the
+     * next input into it.
+     * ******************************************/
+    for (n = 0; n < launches + sets; n++) {
+        s = n % sets;
+
+        // Consume launch n - sets, which used this buffer set
+        if (n >= sets) {
+            trace_begin("consume");
+            err = clWaitForEvents(1, &d2h_events[s]);
+            if (err != CL_SUCCESS) {
+                printf("Error: Failed to wait for launch %d! %d\n", n - sets, err);
+                return EXIT_FAILURE;
+            }
+            record_timeline(&timeline[n - sets], n > sets ? &timeline[n - sets - 1] : NULL, s);
+#ifdef CPU_COSCHEDULE
+            // Stitch the CPU rows into the frames, then rebalance
+            for (i = 0; i < frames; i++) {
+                memcpy(output[s] + i * frame_stride + cpu_row_begin[s] * SIZE_X,
+                       cpu_output[s] + i * frame_stride + cpu_row_begin[s] * SIZE_X,
+                       sizeof(float) * (SIZE_Y - cpu_row_begin[s]) * SIZE_X);
+            }
+            fpga_start = timeline[n - sets].h2d_start;
+            if (n > sets && timeline[n - sets - 1].d2h_end > fpga_start) {
+                fpga_start = timeline[n - sets - 1].d2h_end;
+            }
+            fpga_rows = balance_split(cpu_row_begin[s], (timeline[n - sets].d2h_end - fpga_start) / 1e6,
+                                      SIZE_Y - cpu_row_begin[s], cpu_ms[s]);
+#endif
+            if (n - sets == 0) {
+                compare(output[s]);
+            }
+            if (n - sets == launches - 1 && (launches > 1 || frames > 1)) {
+                compare(output[s] + (frames - 1) * SIZE_X * SIZE_Y);
+            }
+            clReleaseEvent(h2d_events[s]);
+            for (k = 0; k < kernel_count[s]; k++) {
+                clReleaseEvent(kernel_events[s][k]);
+            }
+            clReleaseEvent(d2h_events[s]);
+            session_return(&session, input_buffer[s]);
+            session_return(&session, output_buffer[s]);
+            trace_end();
+        }
+        if (n >= launches) {
+            continue;
+        }
 
-    // Enqueue output memory objects migration - Device -> Host
-	err = clEnqueueMigrateMemObjects(q,(cl_uint)1, pt_out, CL_MIGRATE_MEM_OBJECT_HOST,0,NULL, NULL);
-	if (err != CL_SUCCESS) {
-        printf("Error: Failed to migrate membojects from device: %d!\n", err);
-        return EXIT_FAILURE;
+        // Enqueue input memory objects migration - Host -> Device
+        trace_begin("produce");
+        produce_input(input[s], frames);
+        trace_end();
+        input_buffer[s] = session_buffer(&session, CL_MEM_READ_ONLY, input_size, input[s], &err);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to get input buffer! %d\n", err);
+            return EXIT_FAILURE;
+        }
+        output_buffer[s] = session_buffer(&session, CL_MEM_WRITE_ONLY, buffer_size, output[s], &err);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to get output buffer! %d\n", err);
+            return EXIT_FAILURE;
+        }
+        n_in = 0;
+        pt_in[n_in++] = input_buffer[s];
+        pt_out[0] = output_buffer[s];
+        err = clEnqueueMigrateMemObjects(q,n_in, pt_in, 0 ,0,NULL, &h2d_events[s]);
+        if (err) {
+            printf("Error: Failed to migrate memobjects to device! %d\n", err);
+            return EXIT_FAILURE;
+        }
+
+        // Start kernel execution, every band on its own compute unit.
+        // The bands share the FPGA rows of the frame.
+        cl_event wait_list[2] = {h2d_events[s], gaussian_event};
+#ifndef SPATIAL_ROM
+        cl_uint n_wait = 2;
+#else
+        cl_uint n_wait = 1;
+#endif
+        kernel_count[s] = 0;
+        band_rows = (fpga_rows + bands - 1) / bands;
+        band_rows = (band_rows + band_quantum - 1) / band_quantum * band_quantum;
+        for (b = 0; b < bands; b++) {
+            band_region *band = &band_regions[s][b];
+            row_begin[b] = MIN(b * band_rows, fpga_rows);
+            row_end[b] = MIN(row_begin[b] + band_rows, fpga_rows);
+            if (row_begin[b] == row_end[b]) {
+                continue;
+            }
+            err = update_band(band, input_buffer[s], frames, row_begin[b]);
+            if (err != CL_SUCCESS) {
+                printf("Error: Failed to create the input sub-buffer of band %d! %d\n", b, err);
+                return EXIT_FAILURE;
+            }
+            err = clSetKernelArg(bilateralFilterKernel[s][b], 0, sizeof(cl_mem), &output_buffer[s]);
+            err |= clSetKernelArg(bilateralFilterKernel[s][b], 1, sizeof(cl_mem), &band->input);
+            err |= clSetKernelArg(bilateralFilterKernel[s][b], row_arg, sizeof(int), &row_begin[b]);
+            err |= clSetKernelArg(bilateralFilterKernel[s][b], row_arg + 1, sizeof(int), &row_end[b]);
+            err |= clSetKernelArg(bilateralFilterKernel[s][b], row_arg + 2, sizeof(int), &band->in_row0);
+            err |= clSetKernelArg(bilateralFilterKernel[s][b], row_arg + 3, sizeof(int), &out_row0);
+            if (err != CL_SUCCESS) {
+                printf("Error: Failed to set bilateralFilterKernel arguments! %d\n", err);
+                return EXIT_FAILURE;
+            }
+            err = clEnqueueTask(q, bilateralFilterKernel[s][b], n_wait, wait_list, &kernel_events[s][kernel_count[s]++]);
+            if (err) {
+                printf("Error: Failed to execute kernel! %d\n", err);
+                return EXIT_FAILURE;
+            }
+        }
+
+        // Enqueue output memory objects migration - Device -> Host
+        err = clEnqueueMigrateMemObjects(q,(cl_uint)1, pt_out, CL_MIGRATE_MEM_OBJECT_HOST,kernel_count[s],kernel_events[s], &d2h_events[s]);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to migrate membojects from device: %d!\n", err);
+            return EXIT_FAILURE;
+        }
+        clFlush(q);
+
+#ifdef CPU_COSCHEDULE
+        // Filter the remaining rows on the CPU while the FPGA runs
+        trace_begin("CPU rows");
+        for (i = 0; i < frames; i++) {
+            STATS_FRAME(i);
+#ifdef DEPTH_U16
+            bilateralFilterBandU16(cpu_output[s] + i * frame_stride, input[s] + i * frame_stride, cpu_gaussian,
+                                   SIZE_X, SIZE_Y, FILTER_RADIUS, fpga_rows, SIZE_Y);
+#else
+            bilateralFilterBand(cpu_output[s] + i * frame_stride, input[s] + i * frame_stride, cpu_gaussian,
+                                SIZE_X, SIZE_Y, FILTER_RADIUS, fpga_rows, SIZE_Y);
+#endif
+        }
+        cpu_ms[s] = trace_end();
+        cpu_row_begin[s] = fpga_rows;
+        profile_sample(PROFILE_CPU, cpu_ms[s] * 1000.0);
+#endif
     }
 
     // Wait for execution to finish
 	clFinish(q);
-    TOCK("filter_time:");
-
-
-    // Compare output results with golden
-    TICK();
-    compare();
-    TOCK("compare_time:");
+    perf_end(PERF_FILTER, (long) SIZE_X * SIZE_Y * frames * launches);
+    printf("filter_time:\t%f milliseconds\n", trace_end());
+    printf("frames:\t%d\n", frames * launches);
+    print_timelines(timeline, launches);
+#ifdef CPU_COSCHEDULE
+    printf("split:\tFPGA %d rows (%.1f rows/ms)\tCPU %d rows (%.1f rows/ms)\n",
+           fpga_rows, fpga_rate, SIZE_Y - fpga_rows, cpu_rate);
+#endif
+#ifndef SPATIAL_ROM
+    profile_event(PROFILE_H2D, gaussian_event);
+#endif
+    profile_report();
+    perf_report();
+#ifdef FILTER_STATS
+    stats_report();
+#endif
+    printf("buffer pool:\t%d hits\t%d misses\n", session.pool_hits, session.pool_misses);
+    printf("band buffers:\t%d input sub-buffers created, bands start at multiples of %d rows\n",
+           band_buffers_created, band_quantum);
 
 
     /*****
@@ -421,30 +715,41 @@ int main(int argc, char *argv[]){
      * ***********************************************/
 
     // Release memory objects and other OpenCL objects
-    err = clEnqueueUnmapMemObject(q,input_buffer,input,0,NULL,NULL);
-	if(err != CL_SUCCESS){
-		printf("Error: Failed to unmap device memory input!\n");
-	}
-    err = clEnqueueUnmapMemObject(q,output_buffer,output,0,NULL,NULL);
-	if(err != CL_SUCCESS){
-		printf("Error: Failed to unmap device memory output!\n");
-	}
+#ifndef SPATIAL_ROM
     err = clEnqueueUnmapMemObject(q,gaussian_buffer,gaussian,0,NULL,NULL);
 	if(err != CL_SUCCESS){
 		printf("Error: Failed to unmap device memory gaussian!\n");
 	}
+#endif
     clFinish(q);
 
 
-    clReleaseMemObject(input_buffer);
-	clReleaseMemObject(output_buffer);
-	clReleaseMemObject(gaussian_buffer);
-
-	clReleaseProgram(program);
-    clReleaseKernel(bilateralFilterKernel);
-    clReleaseCommandQueue(q);
-    clReleaseContext(context);
+#ifndef SPATIAL_ROM
+    clReleaseEvent(gaussian_event);
+#endif
+    for (s = 0; s < sets; s++) {
+        for (b = 0; b < bands; b++) {
+            if (band_regions[s][b].input) {
+                clReleaseMemObject(band_regions[s][b].input);
+            }
+        }
+    }
+    // Buffers, kernels, program and device
+    session_close(&session);
+    for (s = 0; s < sets; s++) {
+        free(input[s]);
+        free(output[s]);
+    }
+    free(frame_data);
+#ifdef CPU_COSCHEDULE
+    for (s = 0; s < sets; s++) {
+        free(cpu_output[s]);
+    }
+#endif
+    free(timeline);
+    profile_reset();
+    trace_stop();
 
     return 0;
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,55 @@
+#include "clmock.h"
+#include "filterHLS.h"
+#include "filterTrace.h"
+
+/***********************************************************
+ * Kernels of filterHLS.cpp as seen by the mock OpenCL
+ * runtime (make TARGET=mock). The HLS C++ source is compiled
+ * for the host CPU and every clEnqueueTask on the mock device
+ * calls the matching adapter below with the kernel arguments,
+ * traced as a span on the thread of its compute unit.
+ * *********************************************************/
+
+extern "C" {
+void bilateralFilterKernel(pixel_vec* out, const pixel_vec* in,const float* gaussian,int size_x,int size_y,int r,int frames,int frame_stride,
+		int row_begin,int row_end,int in_row0,int out_row0);
+void bilateralFilterKernelR2W320(pixel_vec* out, const pixel_vec* in,const float* gaussian,int size_x,int size_y,int r,int frames,int frame_stride,
+		int row_begin,int row_end,int in_row0,int out_row0);
+void bilateralFilterKernelR2W640(pixel_vec* out, const pixel_vec* in,const float* gaussian,int size_x,int size_y,int r,int frames,int frame_stride,
+		int row_begin,int row_end,int in_row0,int out_row0);
+void bilateralFilterKernelR4W640(pixel_vec* out, const pixel_vec* in,const float* gaussian,int size_x,int size_y,int r,int frames,int frame_stride,
+		int row_begin,int row_end,int in_row0,int out_row0);
+void bilateralFilterKernelRom(pixel_vec* out, const pixel_vec* in,int size_x,int size_y,int r,int frames,int frame_stride,
+		int row_begin,int row_end,int in_row0,int out_row0);
+void bilateralFilterKernelU16(pixel_vec* out, const depth_vec* in,const float* gaussian,int size_x,int size_y,int r,int frames,int frame_stride,
+		int row_begin,int row_end,int in_row0,int out_row0);
+}
+
+// Calls a kernel with the gaussian buffer argument, reading IN_VEC input
+template <typename IN_VEC, void (*KERNEL)(pixel_vec*, const IN_VEC*, const float*, int, int, int, int, int,
+		int, int, int, int)>
+static void runFilter(void* const* args) {
+	TRACE_SCOPE("kernel");
+	KERNEL((pixel_vec*) args[0], (const IN_VEC*) args[1], (const float*) args[2],
+			CLMOCK_SCALAR(int, args, 3), CLMOCK_SCALAR(int, args, 4), CLMOCK_SCALAR(int, args, 5),
+			CLMOCK_SCALAR(int, args, 6), CLMOCK_SCALAR(int, args, 7), CLMOCK_SCALAR(int, args, 8),
+			CLMOCK_SCALAR(int, args, 9), CLMOCK_SCALAR(int, args, 10), CLMOCK_SCALAR(int, args, 11));
+}
+
+static void runFilterRom(void* const* args) {
+	TRACE_SCOPE("kernel");
+	bilateralFilterKernelRom((pixel_vec*) args[0], (const pixel_vec*) args[1],
+			CLMOCK_SCALAR(int, args, 2), CLMOCK_SCALAR(int, args, 3), CLMOCK_SCALAR(int, args, 4),
+			CLMOCK_SCALAR(int, args, 5), CLMOCK_SCALAR(int, args, 6), CLMOCK_SCALAR(int, args, 7),
+			CLMOCK_SCALAR(int, args, 8), CLMOCK_SCALAR(int, args, 9), CLMOCK_SCALAR(int, args, 10));
+}
+
+const clmock_kernel clmock_kernels[] = {
+	{"bilateralFilterKernel", "mmmsssssssss", runFilter<pixel_vec, bilateralFilterKernel>},
+	{"bilateralFilterKernelR2W320", "mmmsssssssss", runFilter<pixel_vec, bilateralFilterKernelR2W320>},
+	{"bilateralFilterKernelR2W640", "mmmsssssssss", runFilter<pixel_vec, bilateralFilterKernelR2W640>},
+	{"bilateralFilterKernelR4W640", "mmmsssssssss", runFilter<pixel_vec, bilateralFilterKernelR4W640>},
+	{"bilateralFilterKernelRom", "mmsssssssss", runFilterRom},
+	{"bilateralFilterKernelU16", "mmmsssssssss", runFilter<depth_vec, bilateralFilterKernelU16>},
+	{NULL, NULL, NULL},
+};
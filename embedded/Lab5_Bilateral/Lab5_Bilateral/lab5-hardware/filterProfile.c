@@ -0,0 +1,133 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "filterProfile.h"
+
+#define PROFILE_BINS 32 // log2 histogram bins, bin i > 0 holds [2^i, 2^(i+1)) us, bin 0 [0, 2) us
+#define PROFILE_BAR 40  // Width of the largest histogram bar
+
+static const char *stage_names[PROFILE_STAGES] = {"H2D", "kernel", "D2H", "queue", "gap", "CPU"};
+
+// Samples of every stage, in microseconds
+static double *samples[PROFILE_STAGES];
+static int sample_count[PROFILE_STAGES];
+static int sample_capacity[PROFILE_STAGES];
+
+
+/***********************************************************
+ * Function:  profile_reset
+ * *********************************************************/
+void profile_reset(void){
+    int i;
+
+    for (i = 0; i < PROFILE_STAGES; i++) {
+        free(samples[i]);
+        samples[i] = NULL;
+        sample_count[i] = 0;
+        sample_capacity[i] = 0;
+    }
+}
+
+/***********************************************************
+ * Function:  profile_sample
+ * *********************************************************/
+void profile_sample(int stage, double us){
+    if (sample_count[stage] == sample_capacity[stage]) {
+        sample_capacity[stage] = sample_capacity[stage] ? 2 * sample_capacity[stage] : 64;
+        samples[stage] = (double *) realloc(samples[stage], sizeof(double) * sample_capacity[stage]);
+        if (samples[stage] == NULL) {
+            printf("Error: Failed to allocate profile samples\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    samples[stage][sample_count[stage]++] = us;
+}
+
+/***********************************************************
+ * Function:  profile_event
+ * *********************************************************/
+void profile_event(int stage, cl_event event){
+    cl_ulong queued, start, end;
+
+    if (clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &queued, NULL) != CL_SUCCESS ||
+        clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL) != CL_SUCCESS ||
+        clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL) != CL_SUCCESS) {
+        return;
+    }
+    profile_sample(stage, (end - start) / 1000.0);
+    profile_sample(PROFILE_QUEUE, start > queued ? (start - queued) / 1000.0 : 0.0);
+}
+
+static int compare_samples(const void *a, const void *b){
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// Bin of the log2 histogram holding us
+static int histogram_bin(double us){
+    int bin = 0;
+
+    while (us >= 2.0 && bin < PROFILE_BINS - 1) {
+        us /= 2.0;
+        bin++;
+    }
+    return bin;
+}
+
+/***********************************************************
+ * Function:  profile_report
+ * ---------------------------------------------------------
+ * Sorts the samples of every stage, then prints the summary
+ * table and one histogram per stage. Percentiles use the
+ * nearest rank: p of n sorted samples is the one at
+ * ceil(p n / 100) - 1, in integers so that 0.95 n does not
+ * round down.
+ * *********************************************************/
+void profile_report(void){
+    int i, j, n, bin, first, last, peak, bar;
+    int bins[PROFILE_BINS];
+    double sum;
+
+    printf("profile (us):\tstage\tcount\tmin\tmean\tp50\tp95\tmax\n");
+    for (i = 0; i < PROFILE_STAGES; i++) {
+        n = sample_count[i];
+        if (n == 0) {
+            continue;
+        }
+        qsort(samples[i], n, sizeof(double), compare_samples);
+        sum = 0;
+        for (j = 0; j < n; j++) {
+            sum += samples[i][j];
+        }
+        printf("\t\t%s\t%d\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\n", stage_names[i], n, samples[i][0], sum / n,
+               samples[i][(n - 1) / 2], samples[i][(95 * n + 99) / 100 - 1], samples[i][n - 1]);
+    }
+
+    for (i = 0; i < PROFILE_STAGES; i++) {
+        n = sample_count[i];
+        if (n == 0) {
+            continue;
+        }
+        memset(bins, 0, sizeof(bins));
+        peak = 0;
+        for (j = 0; j < n; j++) {
+            bin = histogram_bin(samples[i][j]);
+            bins[bin]++;
+            if (bins[bin] > peak) {
+                peak = bins[bin];
+            }
+        }
+        // The samples are sorted, so the first and last ones give the range
+        first = histogram_bin(samples[i][0]);
+        last = histogram_bin(samples[i][n - 1]);
+        printf("histogram %s (us):\n", stage_names[i]);
+        for (bin = first; bin <= last; bin++) {
+            printf("\t[%8.0f, %8.0f)\t%6d\t", bin ? ldexp(1.0, bin) : 0.0, ldexp(1.0, bin + 1), bins[bin]);
+            for (bar = 0; bar < (bins[bin] * PROFILE_BAR + peak - 1) / peak; bar++) {
+                putchar('#');
+            }
+            putchar('\n');
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef _FILTER_PROFILE_H_
+#define _FILTER_PROFILE_H_
+
+/***********************************************************
+ * Per-stage timing statistics of the filter host, built
+ * from the OpenCL profiling events (the queue must be
+ * created with CL_QUEUE_PROFILING_ENABLE).
+ *
+ * Every sample is kept, so that the report can give exact
+ * percentiles and a log2 histogram of every stage across
+ * all launches of a run.
+ * *********************************************************/
+
+#ifndef CL_TARGET_OPENCL_VERSION
+#define CL_TARGET_OPENCL_VERSION 120
+#endif
+#include <CL/cl.h>
+
+/**
+ * Stages of the report.
+ *  PROFILE_H2D:    input migration, start to end.
+ *  PROFILE_KERNEL: kernel of one band, start to end.
+ *  PROFILE_D2H:    output migration, start to end.
+ *  PROFILE_QUEUE:  any command, enqueued to started. Covers
+ *                  the wait for its dependencies and the
+ *                  runtime overhead.
+ *  PROFILE_GAP:    compute units idle between the end of a
+ *                  launch and the start of the next one, as
+ *                  the host did not provide work in time.
+ *  PROFILE_CPU:    CPU rows of one launch when co-scheduling.
+ * */
+enum profile_stage {
+    PROFILE_H2D,
+    PROFILE_KERNEL,
+    PROFILE_D2H,
+    PROFILE_QUEUE,
+    PROFILE_GAP,
+    PROFILE_CPU,
+    PROFILE_STAGES
+};
+
+// Drops all samples
+void profile_reset(void);
+
+// Adds a duration in microseconds to a stage
+void profile_sample(int stage, double us);
+
+// Adds the execution time of a completed event to stage and
+// its queued to start time to PROFILE_QUEUE
+void profile_event(int stage, cl_event event);
+
+// Prints count, min, mean, p50, p95 and max of every stage
+// with samples, followed by their histograms
+void profile_report(void);
+
+#endif
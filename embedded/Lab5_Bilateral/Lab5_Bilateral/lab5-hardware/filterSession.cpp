@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <string.h>
+#include "filterSession.h"
+#include "filterBuffers.h"
+
+/***********************************************************
+ * Function:  session_open
+ * ---------------------------------------------------------
+ * oclHelper creates an in order queue without profiling,
+ * so it is replaced by the queue the host pipeline needs.
+ * *********************************************************/
+int session_open(filter_session *session, const char *xclbin, const char *kernel_name){
+    cl_int err;
+
+    memset(session, 0, sizeof(*session));
+    session->hardware = getOclHardware(CL_DEVICE_TYPE_ACCELERATOR);
+    if (!session->hardware.mQueue) {
+        printf("Error: Failed to find an accelerator device!\n");
+        return -1;
+    }
+    clReleaseCommandQueue(session->hardware.mQueue);
+    session->hardware.mQueue = clCreateCommandQueue(session->hardware.mContext, session->hardware.mDevice,
+                                                    CL_QUEUE_PROFILING_ENABLE | CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE,
+                                                    &err);
+    if (!session->hardware.mQueue) {
+        printf("Error: Failed to create a command q! Error code: %s\n", oclErrorCode(err));
+        return -2;
+    }
+
+    snprintf(session->software.mFileName, sizeof(session->software.mFileName), "%s", xclbin);
+    snprintf(session->software.mKernelName, sizeof(session->software.mKernelName), "%s", kernel_name);
+    if (getOclSoftware(session->software, session->hardware) != 0) {
+        printf("Error: Failed to load %s from %s!\n", kernel_name, xclbin);
+        return -3;
+    }
+    err = clBuildProgram(session->software.mProgram, 0, NULL, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program executable! %s\n", oclErrorCode(err));
+        return -4;
+    }
+    session->kernels[0] = session->software.mKernel;
+    return 0;
+}
+
+/***********************************************************
+ * Function:  session_kernel
+ * *********************************************************/
+cl_kernel session_kernel(filter_session *session, int index){
+    cl_int err;
+
+    if (index < 0 || index >= SESSION_MAX_KERNELS) {
+        return NULL;
+    }
+    if (!session->kernels[index]) {
+        session->kernels[index] = clCreateKernel(session->software.mProgram, session->software.mKernelName, &err);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to create kernel %d! %s\n", index, oclErrorCode(err));
+            session->kernels[index] = NULL;
+        }
+    }
+    return session->kernels[index];
+}
+
+/***********************************************************
+ * Function:  session_buffer
+ * ---------------------------------------------------------
+ * A free pool entry of the same kind is reused. Otherwise a
+ * new buffer is created and kept in a free slot; when the
+ * pool is full it is still returned, and released once given
+ * back.
+ * *********************************************************/
+cl_mem session_buffer(filter_session *session, cl_mem_flags flags, size_t size, void *host, cl_int *err){
+    session_buffer_entry *free_slot = NULL;
+    cl_mem mem;
+    int i;
+
+    for (i = 0; i < SESSION_POOL_SIZE; i++) {
+        session_buffer_entry *entry = &session->pool[i];
+        if (!entry->mem) {
+            if (!free_slot) {
+                free_slot = entry;
+            }
+            continue;
+        }
+        if (!entry->in_use && entry->flags == flags && entry->size == size && entry->host == host) {
+            entry->in_use = 1;
+            session->pool_hits++;
+            *err = CL_SUCCESS;
+            return entry->mem;
+        }
+    }
+
+    session->pool_misses++;
+    if (host) {
+        mem = frame_buffer(session->hardware.mContext, flags, host, size, "session buffer", err);
+    } else {
+        mem = clCreateBuffer(session->hardware.mContext, flags, size, NULL, err);
+    }
+    if (*err != CL_SUCCESS) {
+        return NULL;
+    }
+    if (free_slot) {
+        free_slot->mem = mem;
+        free_slot->flags = flags;
+        free_slot->size = size;
+        free_slot->host = host;
+        free_slot->in_use = 1;
+    }
+    return mem;
+}
+
+/***********************************************************
+ * Function:  session_return
+ * *********************************************************/
+void session_return(filter_session *session, cl_mem mem){
+    int i;
+
+    for (i = 0; i < SESSION_POOL_SIZE; i++) {
+        if (session->pool[i].mem == mem) {
+            session->pool[i].in_use = 0;
+            return;
+        }
+    }
+    // Created while the pool was full
+    clReleaseMemObject(mem);
+}
+
+/***********************************************************
+ * Function:  session_close
+ * *********************************************************/
+void session_close(filter_session *session){
+    int i;
+
+    clFinish(session->hardware.mQueue);
+    for (i = 0; i < SESSION_POOL_SIZE; i++) {
+        if (session->pool[i].mem) {
+            clReleaseMemObject(session->pool[i].mem);
+        }
+    }
+    // kernels[0] is software.mKernel, released with the program
+    for (i = 1; i < SESSION_MAX_KERNELS; i++) {
+        if (session->kernels[i]) {
+            clReleaseKernel(session->kernels[i]);
+        }
+    }
+    release(session->software);
+    release(session->hardware);
+    memset(session, 0, sizeof(*session));
+}
@@ -0,0 +1,62 @@
+#ifndef _FILTER_SESSION_H_
+#define _FILTER_SESSION_H_
+
+/***********************************************************
+ * Accelerator session: everything that is set up once per
+ * process and reused by every filter request.
+ *
+ * Opening a session finds the Xilinx device, loads the
+ * xclbin and builds the program (oclHelper), then keeps
+ * the kernel handles and a pool of buffers. A request only
+ * takes buffers from the pool, sets kernel arguments and
+ * enqueues commands on session->hardware.mQueue, which is
+ * out of order with profiling enabled.
+ * *********************************************************/
+
+#include "oclHelper.h"
+
+#define SESSION_MAX_KERNELS 64 // Kernel handles kept by a session
+#define SESSION_POOL_SIZE 32   // Buffers kept by a session
+
+/**
+ * A pooled buffer. Runtime allocated buffers are matched by
+ * flags and size, CL_MEM_USE_HOST_PTR buffers also by their
+ * host memory.
+ * */
+typedef struct {
+    cl_mem mem;
+    cl_mem_flags flags;
+    size_t size;
+    void *host;
+    int in_use;
+} session_buffer_entry;
+
+typedef struct {
+    oclHardware hardware;
+    oclSoftware software;
+    cl_kernel kernels[SESSION_MAX_KERNELS];
+    session_buffer_entry pool[SESSION_POOL_SIZE];
+    int pool_hits;
+    int pool_misses;
+} filter_session;
+
+// Opens the device and loads kernel_name from xclbin.
+// Returns 0, or a negative value after printing the error.
+int session_open(filter_session *session, const char *xclbin, const char *kernel_name);
+
+// Returns kernel handle index (< SESSION_MAX_KERNELS), created
+// on first use. Every handle can run on its own compute unit.
+cl_kernel session_kernel(filter_session *session, int index);
+
+// Takes a buffer of size bytes from the pool, or creates one.
+// With a host pointer the buffer uses that memory in place
+// (see frame_buffer).
+cl_mem session_buffer(filter_session *session, cl_mem_flags flags, size_t size, void *host, cl_int *err);
+
+// Gives a buffer of session_buffer back to the pool
+void session_return(filter_session *session, cl_mem mem);
+
+// Releases the buffers, kernels, program and device
+void session_close(filter_session *session);
+
+#endif
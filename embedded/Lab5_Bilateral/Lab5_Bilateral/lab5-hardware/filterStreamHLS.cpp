@@ -0,0 +1,174 @@
+#include <math.h>
+#include "ap_axi_sdata.h"
+#include "hls_stream.h"
+#include "filterHLS.h"
+
+/***********************************************************
+ * Free-running streaming configuration. The frame geometry
+ * and radius are fixed at build time, because the kernel has
+ * no control interface to receive them.
+ * *********************************************************/
+#ifndef STREAM_SIZE_X
+#define STREAM_SIZE_X 320 // Frame width
+#endif
+#ifndef STREAM_SIZE_Y
+#define STREAM_SIZE_Y 240 // Frame height
+#endif
+#ifndef STREAM_RADIUS
+#define STREAM_RADIUS 2   // Filter radius, at most SPATIAL_ROM_RADIUS
+#endif
+
+#define STREAM_WINDOW (2 * STREAM_RADIUS + 1)
+// 2r+1 rows being read and 1 being written
+#define STREAM_RING (2 * STREAM_RADIUS + 2)
+
+/**
+ * One pixel per beat. data holds the float bits, user marks
+ * the first pixel of a frame (SOF) and last the final pixel
+ * of a frame (EOF).
+ * */
+typedef ap_axiu<32, 1, 1, 1> pixel_pkt;
+
+static float pktToFloat(const pixel_pkt &pkt) {
+	union { unsigned int u; float f; } bits;
+	bits.u = pkt.data;
+	return bits.f;
+}
+
+static pixel_pkt floatToPkt(float value, bool sof, bool eof) {
+	union { unsigned int u; float f; } bits;
+	pixel_pkt pkt;
+	bits.f = value;
+	pkt.data = bits.u;
+	pkt.keep = -1;
+	pkt.strb = -1;
+	pkt.user = sof;
+	pkt.last = eof;
+	pkt.id = 0;
+	pkt.dest = 0;
+	return pkt;
+}
+
+/**
+ * Extern is a requirement for Vitis Unified Software Platform,
+ * when we use a .cpp (C++ source code) file.
+ * */
+extern "C" {
+
+/***********************************************************
+ * Function:  bilateralFilterStream
+ * ---------------------------------------------------------
+ * Free-running (ap_ctrl_none) variant of bilateralFilterKernel.
+ * Every invocation consumes one STREAM_SIZE_X x STREAM_SIZE_Y
+ * frame from in and emits the filtered frame on out, and the
+ * kernel restarts by itself for the next frame, so there is no
+ * per-frame launch from the host.
+ *
+ *    +------------+   AXI4-Stream   +--------+   AXI4-Stream   +---------+
+ *    | Camera/DMA +---------------->+ Filter +---------------->+ Consumer|
+ *    +------------+  SOF/EOF side   +--------+  SOF/EOF side   +---------+
+ *
+ * Output row y is produced while input row y + r + 1 arrives.
+ * A frame ends at the beat with TLAST or after W x H beats,
+ * whichever comes first: missing pixels read as 0 (invalid)
+ * and surplus beats are dropped up to TLAST, so the kernel
+ * realigns after a malformed frame.
+ *
+ * Rows of a stream can not be read ahead, so taps outside the
+ * frame replicate the nearest border pixel instead of reading
+ * the last row/column like the memory-mapped kernel.
+ *
+ *  out: The filtered pixel stream.
+ *
+ *  in: The input pixel stream.
+ *************************************************************/
+void bilateralFilterStream(hls::stream<pixel_pkt> &in, hls::stream<pixel_pkt> &out) {
+	#pragma HLS INTERFACE axis port=in
+	#pragma HLS INTERFACE axis port=out
+	#pragma HLS INTERFACE ap_ctrl_none port=return
+
+	float lineBuffer[STREAM_RING][STREAM_SIZE_X];
+	#pragma HLS ARRAY_PARTITION variable=lineBuffer complete dim=1
+	#pragma HLS DEPENDENCE variable=lineBuffer inter false
+
+	float window[STREAM_WINDOW][STREAM_WINDOW];
+	#pragma HLS ARRAY_PARTITION variable=window complete dim=0
+
+	int source[STREAM_WINDOW];
+	#pragma HLS ARRAY_PARTITION variable=source complete
+
+	int i,j,k,s,t;
+	bool ended = false;
+
+	for (s = 0; s < STREAM_SIZE_Y + STREAM_RADIUS + 1; s++) {
+		const int y = s - STREAM_RADIUS - 1; // Row computed during this step
+		const bool doRead = s < STREAM_SIZE_Y;
+		const bool doCompute = y >= 0;
+
+		for (k = 0; k < STREAM_WINDOW; k++) {
+			#pragma HLS UNROLL
+			const int yy = MAX(0, MIN(y + k - STREAM_RADIUS, STREAM_SIZE_Y - 1));
+			source[k] = yy % STREAM_RING;
+		}
+
+		// The window starts r columns left of the row, clamped to column 0
+		for (t = -STREAM_RADIUS; t < STREAM_SIZE_X + STREAM_RADIUS; t++) {
+			#pragma HLS PIPELINE II=1
+
+			if (doRead && t >= 0 && t < STREAM_SIZE_X) {
+				float value = 0.0f;
+				if (!ended) {
+					const pixel_pkt pkt = in.read();
+					value = pktToFloat(pkt);
+					ended = pkt.last;
+				}
+				lineBuffer[s % STREAM_RING][t] = value;
+			}
+
+			if (!doCompute) {
+				continue;
+			}
+
+			const int loadCol = MAX(0, MIN(t, STREAM_SIZE_X - 1));
+			for (k = 0; k < STREAM_WINDOW; k++) {
+				for (j = 0; j < STREAM_WINDOW - 1; j++) {
+					window[k][j] = window[k][j + 1];
+				}
+				window[k][STREAM_WINDOW - 1] = lineBuffer[source[k]][loadCol];
+			}
+
+			const int x = t - STREAM_RADIUS;
+			if (x < 0) {
+				continue;
+			}
+
+			const float center = window[STREAM_RADIUS][STREAM_RADIUS];
+			float sum = 0.0f;
+			float acc = 0.0f;
+
+			for (i = -STREAM_RADIUS; i <= STREAM_RADIUS; ++i) {
+				for (j = -STREAM_RADIUS; j <= STREAM_RADIUS; ++j) {
+					const float curPix = window[j + STREAM_RADIUS][i + STREAM_RADIUS];
+					if (curPix > 0) {
+						const float mod = (curPix - center) * (curPix - center);
+						const float factor = spatialRom[i < 0 ? -i : i][j < 0 ? -j : j]
+								* expf(-mod / 0.02f);
+						acc += factor * curPix;
+						sum += factor;
+					}
+				}
+			}
+
+			const bool sof = y == 0 && x == 0;
+			const bool eof = y == STREAM_SIZE_Y - 1 && x == STREAM_SIZE_X - 1;
+			out.write(floatToPkt((center == 0) ? 0.0f : acc / sum, sof, eof));
+		}
+	}
+
+	// Drop whatever is left of an oversized frame
+	while (!ended) {
+		ended = in.read().last;
+	}
+}
+
+}
@@ -0,0 +1,265 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "time.h"
+// SIZE_X and SIZE_Y must match STREAM_SIZE_X and STREAM_SIZE_Y of the kernel
+#include "filterCommon.h"
+#include "filterTrace.h"
+
+#define FRAMES 64  // Default number of frames pushed through the stream
+
+/**** OpenCL and Xilinx stream extensions ****/
+#include "xcl2.hpp"
+
+// Function pointers of xcl::Stream, resolved by xcl::Stream::init()
+decltype(&clCreateStream) xcl::Stream::createStream = nullptr;
+decltype(&clReleaseStream) xcl::Stream::releaseStream = nullptr;
+decltype(&clReadStream) xcl::Stream::readStream = nullptr;
+decltype(&clWriteStream) xcl::Stream::writeStream = nullptr;
+decltype(&clPollStreams) xcl::Stream::pollStreams = nullptr;
+
+/**** OpenCL API variables ****/
+cl_int err;
+
+cl_platform_id platform_id;
+cl_platform_id platforms[16];
+cl_uint platform_count;
+cl_uint platform_found = 0;
+char cl_platform_vendor[1001];
+
+cl_uint num_devices;
+cl_device_id devices[16];
+cl_device_id device_id;
+
+cl_context context;
+cl_command_queue q;
+cl_program program;
+
+cl_kernel bilateralFilterStream; // Handler for the free-running kernel
+
+cl_stream input_stream;  // Host -> kernel "in" port
+cl_stream output_stream; // Kernel "out" port -> host
+
+// Input frames, FRAMES copies of input.bin back to back
+float *input;
+// Output frames
+float *output;
+
+
+/***********************************************************
+ * Function:  read_frames
+ * ---------------------------------------------------------
+ * Reads the input.bin file into the first frame of the
+ * input array and replicates it to the other frames.
+ * *********************************************************/
+void read_frames(int frames){
+    int f;
+
+    read_input(input);
+    for (f = 1; f < frames; f++) {
+        memcpy(input + f * SIZE_X * SIZE_Y, input, sizeof(float) * SIZE_X * SIZE_Y);
+    }
+}
+
+/***********************************************************
+ * Function:  main
+ * ---------------------------------------------------------
+ * Pushes a sequence of frames through the free-running
+ * bilateralFilterStream kernel with Xilinx host streams.
+ *
+ * Host streams need a platform with streaming support
+ * (e.g. QDMA based Alveo shells). On the ZCU102 the same
+ * kernel is linked to the camera/DMA IP with stream_connect
+ * in design_stream.cfg instead.
+ * *********************************************************/
+int main(int argc, char *argv[]){
+    size_t frame_size = sizeof(float) * SIZE_X * SIZE_Y;
+    size_t n0, len;
+    cl_uint iplat;
+    char *hw_binary_path;
+    char buffer[2048];
+    int frames = FRAMES;
+    int f, num_compl;
+
+    if ( argc < 2) {
+        printf("1 Argument needed : <*.xclbin path> [frames]");
+        return EXIT_FAILURE;
+    }
+    hw_binary_path = argv[1];
+    if (argc > 2) {
+        frames = atoi(argv[2]);
+    }
+    if (frames < 1) {
+        printf("Error: frames must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    /**************************************************
+	* Step 1: Get the Xilinx platform and device.
+	**************************************************/
+	err = clGetPlatformIDs(16, platforms, &platform_count);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to find an OpenCL platform!\n");
+        return EXIT_FAILURE;
+    }
+	for (iplat=0; iplat<platform_count; iplat++) {
+		err = clGetPlatformInfo(platforms[iplat], CL_PLATFORM_VENDOR, 1000, (void *)cl_platform_vendor,NULL);
+        if (err != CL_SUCCESS) {
+            printf("Error: clGetPlatformInfo(CL_PLATFORM_VENDOR) failed!\n");
+            return EXIT_FAILURE;
+        }
+        if (strcmp(cl_platform_vendor, "Xilinx") == 0) {
+            platform_id = platforms[iplat];
+            platform_found = 1;
+        }
+    }
+    if (!platform_found) {
+        printf("ERROR: Platform Xilinx not found. Exit.\n");
+        return EXIT_FAILURE;
+    }
+	err = clGetDeviceIDs(platform_id, CL_DEVICE_TYPE_ACCELERATOR, 16, devices, &num_devices);
+    if (err != CL_SUCCESS) {
+        printf("ERROR: Failed to create a device group!\n");
+        return EXIT_FAILURE;
+    }
+	device_id = devices[0];
+
+	// ---------------------------------------------------------------
+	// Step 2 : Create Context and Command Queue
+	// ---------------------------------------------------------------
+	context = clCreateContext(0,1,&device_id,NULL,NULL,&err);
+	if (!context) {
+        printf("Error: Failed to create a compute context!\n");
+        return EXIT_FAILURE;
+    }
+	q = clCreateCommandQueue(context, device_id, CL_QUEUE_PROFILING_ENABLE, &err);
+	if (!q) {
+        printf("Error: Failed to create a command q! Error code: %i\n",err);
+        return EXIT_FAILURE;
+    }
+
+	// ---------------------------------------------------------------
+	// Step 3 : Program the device. A free-running kernel starts as
+	//          soon as the xclbin is loaded, it is never enqueued.
+	// ---------------------------------------------------------------
+    std::vector<unsigned char> binary = xcl::read_binary_file(hw_binary_path);
+    const unsigned char *binary_data = binary.data();
+    n0 = binary.size();
+    program = clCreateProgramWithBinary(context, 1, &device_id, &n0,
+                                        &binary_data, NULL, &err);
+    if ((!program) || (err!=CL_SUCCESS)) {
+        printf("Error: Failed to create compute program from binary %d!\n", err);
+        exit(EXIT_FAILURE);
+    }
+	err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+	if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program executable!\n");
+        clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, &len);
+        printf("%s\n", buffer);
+        exit(EXIT_FAILURE);
+    }
+	bilateralFilterStream = clCreateKernel(program, "bilateralFilterStream", &err);
+    if (!bilateralFilterStream || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute bilateralFilterStream!\n");
+		exit(EXIT_FAILURE);
+    }
+
+	// ---------------------------------------------------------------
+	// Step 4 : Open one host stream per kernel AXI4-Stream port.
+	//          ext.flags is the kernel argument index of the port.
+	// ---------------------------------------------------------------
+    xcl::Stream::init(platform_id);
+
+    cl_mem_ext_ptr_t ext;
+    ext.param = bilateralFilterStream;
+    ext.obj = NULL;
+
+    ext.flags = 0; // in
+    input_stream = xcl::Stream::createStream(device_id, CL_STREAM_WRITE_ONLY, CL_STREAM, &ext, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create input stream! %d\n", err);
+        return EXIT_FAILURE;
+    }
+    ext.flags = 1; // out
+    output_stream = xcl::Stream::createStream(device_id, CL_STREAM_READ_ONLY, CL_STREAM, &ext, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create output stream! %d\n", err);
+        return EXIT_FAILURE;
+    }
+
+    /****
+     * Data initialization. Page aligned, as the stream DMA
+     * requires it to avoid bounce buffers.
+     * **************************/
+    trace_start(getenv("FILTER_TRACE"));
+    trace_begin("load");
+    input = (float *) frame_alloc(frame_size * frames);
+    output = (float *) frame_alloc(frame_size * frames);
+    read_frames(frames);
+    printf("load_time:\t%f milliseconds\n", trace_end());
+
+    /*****
+     * Stream all frames. Each frame is one transfer with
+     * end-of-transfer, which raises TLAST on its last pixel.
+     * The reads are posted first so that the kernel never
+     * stalls on a full output stream.
+     * **************************/
+    trace_begin("filter");
+    std::vector<cl_streams_poll_req_completions> completions(2 * frames);
+    for (f = 0; f < frames; f++) {
+        cl_stream_xfer_req rd_req {0};
+        rd_req.flags = CL_STREAM_EOT | CL_STREAM_NONBLOCKING;
+        rd_req.priv_data = (void *)"read";
+        xcl::Stream::readStream(output_stream, output + f * SIZE_X * SIZE_Y, frame_size, &rd_req, &err);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to post stream read %d! %d\n", f, err);
+            return EXIT_FAILURE;
+        }
+    }
+    for (f = 0; f < frames; f++) {
+        cl_stream_xfer_req wr_req {0};
+        wr_req.flags = CL_STREAM_EOT | CL_STREAM_NONBLOCKING;
+        wr_req.priv_data = (void *)"write";
+        xcl::Stream::writeStream(input_stream, input + f * SIZE_X * SIZE_Y, frame_size, &wr_req, &err);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to post stream write %d! %d\n", f, err);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Wait for every read and write request to complete
+    num_compl = 2 * frames;
+    xcl::Stream::pollStreams(device_id, completions.data(), 2 * frames, 2 * frames, &num_compl, 50000, &err);
+    if (err != CL_SUCCESS || num_compl != 2 * frames) {
+        printf("Error: Stream transfers did not complete (%d of %d)! %d\n", num_compl, 2 * frames, err);
+        return EXIT_FAILURE;
+    }
+    printf("filter_time:\t%f milliseconds\n", trace_end());
+    printf("frames:\t%d\n", frames);
+
+    // Compare the first and the last frame with golden. The
+    // streaming kernel replicates border pixels, so expect a
+    // tiny non zero MSE (about 1e-6) compared to the
+    // memory-mapped kernel.
+    trace_begin("compare");
+    compare(output);
+    compare(output + (frames - 1) * SIZE_X * SIZE_Y);
+    printf("compare_time:\t%f milliseconds\n", trace_end());
+
+    /*****
+     * Clean up code.
+     * ***********************************************/
+    xcl::Stream::releaseStream(input_stream);
+    xcl::Stream::releaseStream(output_stream);
+    free(input);
+    free(output);
+
+	clReleaseProgram(program);
+    clReleaseKernel(bilateralFilterStream);
+    clReleaseCommandQueue(q);
+    clReleaseContext(context);
+    trace_stop();
+
+    return 0;
+}
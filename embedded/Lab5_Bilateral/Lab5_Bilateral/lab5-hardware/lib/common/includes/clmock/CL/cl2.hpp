@@ -0,0 +1,7 @@
+/**********
+Stand-in for the Khronos C++ bindings when building against the mock
+runtime. The host programs only call the C API, so this forwards to cl.h.
+**********/
+#pragma once
+
+#include <CL/cl.h>
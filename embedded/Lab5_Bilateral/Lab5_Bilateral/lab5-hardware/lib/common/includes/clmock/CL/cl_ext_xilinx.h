@@ -0,0 +1,13 @@
+/**********
+Stand-in for the Xilinx OpenCL extensions header when building against
+the mock runtime. Only the queries the host programs use are provided.
+**********/
+#ifndef _CLMOCK_CL_EXT_XILINX_H_
+#define _CLMOCK_CL_EXT_XILINX_H_
+
+#include <CL/cl.h>
+
+/* cl_kernel_info: number of compute units of a kernel in the xclbin */
+#define CL_KERNEL_COMPUTE_UNIT_COUNT 0x4040
+
+#endif
@@ -0,0 +1,1147 @@
+/**********
+Mock OpenCL runtime.
+
+Implements the subset of the OpenCL 1.2 API declared in CL/cl.h on the
+host CPU, so that host programs can be built, benchmarked and regression
+tested without a board or XRT. clEnqueueTask calls the kernel function
+registered in clmock_kernels[] (see clmock.h).
+
+Device model:
+ - One "Xilinx" platform with one accelerator device.
+ - Every buffer has a host copy (what clEnqueueMapBuffer returns) and a
+   separate device copy (what kernels see). clEnqueueMigrateMemObjects
+   copies between them, so a missing migration shows up as wrong data.
+   A CL_MEM_USE_HOST_PTR buffer with a page aligned pointer shares one
+   copy, like the zero-copy path of XRT on an MPSoC.
+ - Commands run asynchronously on worker threads, honouring in-order
+   queues and event wait lists. Kernels run on CLMOCK_CUS compute units
+   and migrations on CLMOCK_DMA engines in parallel, and every event
+   records queued/submit/start/end profiling timestamps.
+
+Environment variables:
+ - CLMOCK_CUS: compute units per kernel (default 1).
+ - CLMOCK_DMA: concurrent buffer migrations (default 2).
+ - CLMOCK_BASE_ADDR_ALIGN: CL_DEVICE_MEM_BASE_ADDR_ALIGN in bits (default 4096).
+**********/
+#include "clmock.h"
+#include <CL/cl_ext_xilinx.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+//
+// Object definitions
+//
+struct _cl_platform_id {
+    int unused;
+};
+
+struct _cl_device_id {
+    int unused;
+};
+
+struct _cl_context {
+    std::atomic<int> refs;
+};
+
+struct _cl_command_queue {
+    std::atomic<int> refs;
+    cl_command_queue_properties properties;
+    cl_event last;   // Last command, for in-order queues
+    int outstanding; // Commands not complete yet
+};
+
+struct _cl_mem {
+    std::atomic<int> refs;
+    cl_mem_flags flags;
+    size_t size;
+    size_t offset;   // Origin inside the parent of a sub-buffer
+    cl_mem parent;
+    char *host;
+    char *device;
+    bool ownsHost;
+    bool ownsDevice;
+};
+
+struct _cl_program {
+    std::atomic<int> refs;
+};
+
+struct _cl_kernel {
+    std::atomic<int> refs;
+    const clmock_kernel *def;
+    std::vector<std::vector<char> > args;
+    std::vector<bool> argSet;
+};
+
+struct _cl_event {
+    std::atomic<int> refs;
+    cl_command_type type;
+    cl_command_queue queue;
+    cl_int status;
+    cl_ulong queued;
+    cl_ulong submit;
+    cl_ulong start;
+    cl_ulong end;
+    std::vector<std::pair<void (*)(cl_event, cl_int, void *), void *> > callbacks;
+};
+
+namespace {
+
+_cl_platform_id thePlatform;
+_cl_device_id theDevice;
+
+int envInt(const char *name, int fallback) {
+    const char *value = getenv(name);
+    if (value == NULL || atoi(value) <= 0) {
+        return fallback;
+    }
+    return atoi(value);
+}
+
+int computeUnits() {
+    return envInt("CLMOCK_CUS", 1);
+}
+
+cl_ulong nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (cl_ulong)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+template <typename T>
+cl_int setInfo(const T &value, size_t size, void *out, size_t *sizeRet) {
+    if (sizeRet) {
+        *sizeRet = sizeof(T);
+    }
+    if (out) {
+        if (size < sizeof(T)) {
+            return CL_INVALID_VALUE;
+        }
+        memcpy(out, &value, sizeof(T));
+    }
+    return CL_SUCCESS;
+}
+
+cl_int setInfoString(const char *value, size_t size, void *out, size_t *sizeRet) {
+    size_t length = strlen(value) + 1;
+    if (sizeRet) {
+        *sizeRet = length;
+    }
+    if (out) {
+        if (size < length) {
+            return CL_INVALID_VALUE;
+        }
+        memcpy(out, value, length);
+    }
+    return CL_SUCCESS;
+}
+
+void setError(cl_int *errcodeRet, cl_int err) {
+    if (errcodeRet) {
+        *errcodeRet = err;
+    }
+}
+
+void releaseEvent(cl_event event) {
+    if (--event->refs == 0) {
+        delete event;
+    }
+}
+
+//
+// Command scheduler
+//
+enum Engine { ENGINE_NONE, ENGINE_CU, ENGINE_DMA };
+
+struct Command {
+    cl_event event;
+    std::vector<cl_event> deps;
+    Engine engine;
+    std::function<void()> work;
+};
+
+class Scheduler {
+  public:
+    Scheduler() : mStop(false), mStarted(false), mFreeCus(0), mFreeDma(0) {}
+
+    ~Scheduler() {
+        {
+            std::lock_guard<std::mutex> guard(mLock);
+            mStop = true;
+        }
+        mReady.notify_all();
+        for (size_t i = 0; i < mWorkers.size(); i++) {
+            mWorkers[i].join();
+        }
+    }
+
+    // Queues work behind the wait list (and the previous command of an
+    // in-order queue). Returns the new event, owned by the caller.
+    cl_event submit(cl_command_queue queue, cl_command_type type, Engine engine,
+                    cl_uint numDeps, const cl_event *deps, std::function<void()> work) {
+        cl_event event = new _cl_event();
+        event->refs = 1;
+        event->type = type;
+        event->queue = queue;
+        event->status = CL_QUEUED;
+        event->queued = nowNs();
+        event->submit = event->start = event->end = 0;
+
+        Command *command = new Command();
+        command->event = event;
+        command->engine = engine;
+        command->work = work;
+        event->refs++; // Held by the command until it completes
+
+        std::unique_lock<std::mutex> guard(mLock);
+        start();
+        for (cl_uint i = 0; i < numDeps; i++) {
+            deps[i]->refs++;
+            command->deps.push_back(deps[i]);
+        }
+        if (!(queue->properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)) {
+            if (queue->last) {
+                command->deps.push_back(queue->last); // Reference moves to the command
+            }
+            event->refs++;
+            queue->last = event;
+        }
+        queue->outstanding++;
+        event->status = CL_SUBMITTED;
+        event->submit = nowNs();
+        mPending.push_back(command);
+        guard.unlock();
+        mReady.notify_all();
+        return event;
+    }
+
+    void wait(cl_uint count, const cl_event *events) {
+        std::unique_lock<std::mutex> guard(mLock);
+        mReady.wait(guard, [&] {
+            for (cl_uint i = 0; i < count; i++) {
+                if (events[i]->status > CL_COMPLETE) {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+
+    void finish(cl_command_queue queue) {
+        std::unique_lock<std::mutex> guard(mLock);
+        mReady.wait(guard, [&] { return queue->outstanding == 0; });
+    }
+
+    cl_int status(cl_event event) {
+        std::lock_guard<std::mutex> guard(mLock);
+        return event->status;
+    }
+
+    // Registers a callback, or returns false if the event already completed
+    bool addCallback(cl_event event, void (*notify)(cl_event, cl_int, void *), void *userData) {
+        std::lock_guard<std::mutex> guard(mLock);
+        if (event->status == CL_COMPLETE) {
+            return false;
+        }
+        event->callbacks.push_back(std::make_pair(notify, userData));
+        return true;
+    }
+
+  private:
+    // Called with mLock held
+    void start() {
+        if (mStarted) {
+            return;
+        }
+        mStarted = true;
+        mFreeCus = computeUnits();
+        mFreeDma = envInt("CLMOCK_DMA", 2);
+        int threads = mFreeCus + mFreeDma + 1;
+        for (int i = 0; i < threads; i++) {
+            mWorkers.push_back(std::thread(&Scheduler::worker, this));
+        }
+    }
+
+    // Called with mLock held
+    std::deque<Command *>::iterator findReady() {
+        for (std::deque<Command *>::iterator it = mPending.begin(); it != mPending.end(); ++it) {
+            Command *command = *it;
+            if ((command->engine == ENGINE_CU && mFreeCus == 0) ||
+                (command->engine == ENGINE_DMA && mFreeDma == 0)) {
+                continue;
+            }
+            bool ready = true;
+            for (size_t i = 0; i < command->deps.size(); i++) {
+                if (command->deps[i]->status > CL_COMPLETE) {
+                    ready = false;
+                    break;
+                }
+            }
+            if (ready) {
+                return it;
+            }
+        }
+        return mPending.end();
+    }
+
+    void worker() {
+        std::unique_lock<std::mutex> guard(mLock);
+        while (true) {
+            std::deque<Command *>::iterator it;
+            mReady.wait(guard, [&] { return mStop || (it = findReady()) != mPending.end(); });
+            if (mStop) {
+                return;
+            }
+            Command *command = *it;
+            mPending.erase(it);
+            if (command->engine == ENGINE_CU) {
+                mFreeCus--;
+            } else if (command->engine == ENGINE_DMA) {
+                mFreeDma--;
+            }
+            cl_event event = command->event;
+            event->status = CL_RUNNING;
+            event->start = nowNs();
+            guard.unlock();
+
+            command->work();
+
+            guard.lock();
+            event->end = nowNs();
+            event->status = CL_COMPLETE;
+            if (command->engine == ENGINE_CU) {
+                mFreeCus++;
+            } else if (command->engine == ENGINE_DMA) {
+                mFreeDma++;
+            }
+            event->queue->outstanding--;
+            std::vector<std::pair<void (*)(cl_event, cl_int, void *), void *> > callbacks;
+            callbacks.swap(event->callbacks);
+            for (size_t i = 0; i < command->deps.size(); i++) {
+                releaseEvent(command->deps[i]);
+            }
+            guard.unlock();
+            mReady.notify_all();
+
+            for (size_t i = 0; i < callbacks.size(); i++) {
+                callbacks[i].first(event, CL_COMPLETE, callbacks[i].second);
+            }
+            releaseEvent(event);
+            delete command;
+            guard.lock();
+        }
+    }
+
+    std::mutex mLock;
+    std::condition_variable mReady;
+    std::deque<Command *> mPending;
+    std::vector<std::thread> mWorkers;
+    bool mStop;
+    bool mStarted;
+    int mFreeCus;
+    int mFreeDma;
+};
+
+Scheduler theScheduler;
+
+// Hands the event to the caller, or drops it when not requested
+void returnEvent(cl_event created, cl_event *event) {
+    if (event) {
+        *event = created;
+    } else {
+        releaseEvent(created);
+    }
+}
+
+cl_int checkWaitList(cl_uint numEvents, const cl_event *events) {
+    if ((numEvents == 0) != (events == NULL)) {
+        return CL_INVALID_EVENT_WAIT_LIST;
+    }
+    for (cl_uint i = 0; i < numEvents; i++) {
+        if (events[i] == NULL) {
+            return CL_INVALID_EVENT_WAIT_LIST;
+        }
+    }
+    return CL_SUCCESS;
+}
+
+const clmock_kernel *findKernel(const char *name) {
+    // Compute unit selection "kernel:{instance}" is ignored, any CU runs it
+    std::string base(name);
+    size_t colon = base.find(':');
+    if (colon != std::string::npos) {
+        base = base.substr(0, colon);
+    }
+    for (const clmock_kernel *k = clmock_kernels; k->name; k++) {
+        if (base == k->name) {
+            return k;
+        }
+    }
+    return NULL;
+}
+
+} // namespace
+
+//
+// Platform and device
+//
+cl_int clGetPlatformIDs(cl_uint num_entries, cl_platform_id *platforms, cl_uint *num_platforms) {
+    if ((num_entries == 0 && platforms) || (!platforms && !num_platforms)) {
+        return CL_INVALID_VALUE;
+    }
+    if (platforms) {
+        platforms[0] = &thePlatform;
+    }
+    if (num_platforms) {
+        *num_platforms = 1;
+    }
+    return CL_SUCCESS;
+}
+
+cl_int clGetPlatformInfo(cl_platform_id platform, cl_platform_info param_name, size_t param_value_size,
+                         void *param_value, size_t *param_value_size_ret) {
+    if (platform != &thePlatform) {
+        return CL_INVALID_PLATFORM;
+    }
+    switch (param_name) {
+    case CL_PLATFORM_PROFILE:
+        return setInfoString("EMBEDDED_PROFILE", param_value_size, param_value, param_value_size_ret);
+    case CL_PLATFORM_VERSION:
+        return setInfoString("OpenCL 1.2 clmock", param_value_size, param_value, param_value_size_ret);
+    case CL_PLATFORM_NAME:
+    case CL_PLATFORM_VENDOR:
+        return setInfoString("Xilinx", param_value_size, param_value, param_value_size_ret);
+    case CL_PLATFORM_EXTENSIONS:
+        return setInfoString("", param_value_size, param_value, param_value_size_ret);
+    }
+    return CL_INVALID_VALUE;
+}
+
+cl_int clGetDeviceIDs(cl_platform_id platform, cl_device_type device_type, cl_uint num_entries,
+                      cl_device_id *devices, cl_uint *num_devices) {
+    if (platform != &thePlatform) {
+        return CL_INVALID_PLATFORM;
+    }
+    if (!(device_type & (CL_DEVICE_TYPE_ACCELERATOR | CL_DEVICE_TYPE_DEFAULT))) {
+        if (num_devices) {
+            *num_devices = 0;
+        }
+        return CL_DEVICE_NOT_FOUND;
+    }
+    if ((num_entries == 0 && devices) || (!devices && !num_devices)) {
+        return CL_INVALID_VALUE;
+    }
+    if (devices) {
+        devices[0] = &theDevice;
+    }
+    if (num_devices) {
+        *num_devices = 1;
+    }
+    return CL_SUCCESS;
+}
+
+cl_int clGetDeviceInfo(cl_device_id device, cl_device_info param_name, size_t param_value_size,
+                       void *param_value, size_t *param_value_size_ret) {
+    if (device != &theDevice) {
+        return CL_INVALID_DEVICE;
+    }
+    switch (param_name) {
+    case CL_DEVICE_TYPE:
+        return setInfo<cl_device_type>(CL_DEVICE_TYPE_ACCELERATOR, param_value_size, param_value,
+                                       param_value_size_ret);
+    case CL_DEVICE_MAX_COMPUTE_UNITS:
+        return setInfo<cl_uint>(computeUnits(), param_value_size, param_value, param_value_size_ret);
+    case CL_DEVICE_MAX_MEM_ALLOC_SIZE:
+        return setInfo<cl_ulong>(1ull << 30, param_value_size, param_value, param_value_size_ret);
+    case CL_DEVICE_MEM_BASE_ADDR_ALIGN:
+        return setInfo<cl_uint>(envInt("CLMOCK_BASE_ADDR_ALIGN", 4096), param_value_size, param_value,
+                                param_value_size_ret);
+    case CL_DEVICE_GLOBAL_MEM_SIZE:
+        return setInfo<cl_ulong>(4ull << 30, param_value_size, param_value, param_value_size_ret);
+    case CL_DEVICE_NAME:
+        return setInfoString("clmock", param_value_size, param_value, param_value_size_ret);
+    case CL_DEVICE_VENDOR:
+        return setInfoString("Xilinx", param_value_size, param_value, param_value_size_ret);
+    case CL_DRIVER_VERSION:
+        return setInfoString("1.0", param_value_size, param_value, param_value_size_ret);
+    case CL_DEVICE_VERSION:
+        return setInfoString("OpenCL 1.2 clmock", param_value_size, param_value, param_value_size_ret);
+    }
+    return CL_INVALID_VALUE;
+}
+
+cl_int clReleaseDevice(cl_device_id device) {
+    return device == &theDevice ? CL_SUCCESS : CL_INVALID_DEVICE;
+}
+
+void *clGetExtensionFunctionAddressForPlatform(cl_platform_id, const char *) {
+    // No extensions, in particular no host streams
+    return NULL;
+}
+
+//
+// Context and command queue
+//
+cl_context clCreateContext(const cl_context_properties *, cl_uint num_devices, const cl_device_id *devices,
+                           void (*)(const char *, const void *, size_t, void *), void *,
+                           cl_int *errcode_ret) {
+    if (num_devices != 1 || !devices || devices[0] != &theDevice) {
+        setError(errcode_ret, CL_INVALID_DEVICE);
+        return NULL;
+    }
+    cl_context context = new _cl_context();
+    context->refs = 1;
+    setError(errcode_ret, CL_SUCCESS);
+    return context;
+}
+
+cl_context clCreateContextFromType(const cl_context_properties *properties, cl_device_type device_type,
+                                   void (*pfn_notify)(const char *, const void *, size_t, void *),
+                                   void *user_data, cl_int *errcode_ret) {
+    if (!(device_type & (CL_DEVICE_TYPE_ACCELERATOR | CL_DEVICE_TYPE_DEFAULT))) {
+        setError(errcode_ret, CL_DEVICE_NOT_FOUND);
+        return NULL;
+    }
+    cl_device_id device = &theDevice;
+    return clCreateContext(properties, 1, &device, pfn_notify, user_data, errcode_ret);
+}
+
+cl_int clReleaseContext(cl_context context) {
+    if (!context) {
+        return CL_INVALID_CONTEXT;
+    }
+    if (--context->refs == 0) {
+        delete context;
+    }
+    return CL_SUCCESS;
+}
+
+cl_command_queue clCreateCommandQueue(cl_context context, cl_device_id device,
+                                      cl_command_queue_properties properties, cl_int *errcode_ret) {
+    if (!context) {
+        setError(errcode_ret, CL_INVALID_CONTEXT);
+        return NULL;
+    }
+    if (device != &theDevice) {
+        setError(errcode_ret, CL_INVALID_DEVICE);
+        return NULL;
+    }
+    cl_command_queue queue = new _cl_command_queue();
+    queue->refs = 1;
+    queue->properties = properties;
+    queue->last = NULL;
+    queue->outstanding = 0;
+    setError(errcode_ret, CL_SUCCESS);
+    return queue;
+}
+
+cl_int clReleaseCommandQueue(cl_command_queue command_queue) {
+    if (!command_queue) {
+        return CL_INVALID_COMMAND_QUEUE;
+    }
+    if (--command_queue->refs == 0) {
+        theScheduler.finish(command_queue);
+        if (command_queue->last) {
+            releaseEvent(command_queue->last);
+        }
+        delete command_queue;
+    }
+    return CL_SUCCESS;
+}
+
+cl_int clFlush(cl_command_queue command_queue) {
+    // Commands are submitted as soon as they are enqueued
+    return command_queue ? CL_SUCCESS : CL_INVALID_COMMAND_QUEUE;
+}
+
+cl_int clFinish(cl_command_queue command_queue) {
+    if (!command_queue) {
+        return CL_INVALID_COMMAND_QUEUE;
+    }
+    theScheduler.finish(command_queue);
+    return CL_SUCCESS;
+}
+
+//
+// Memory objects
+//
+cl_mem clCreateBuffer(cl_context context, cl_mem_flags flags, size_t size, void *host_ptr,
+                      cl_int *errcode_ret) {
+    if (!context) {
+        setError(errcode_ret, CL_INVALID_CONTEXT);
+        return NULL;
+    }
+    if (size == 0) {
+        setError(errcode_ret, CL_INVALID_BUFFER_SIZE);
+        return NULL;
+    }
+    bool needsPtr = (flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR)) != 0;
+    if (needsPtr != (host_ptr != NULL) ||
+        ((flags & CL_MEM_USE_HOST_PTR) && (flags & (CL_MEM_COPY_HOST_PTR | CL_MEM_ALLOC_HOST_PTR)))) {
+        setError(errcode_ret, CL_INVALID_HOST_PTR);
+        return NULL;
+    }
+
+    cl_mem mem = new _cl_mem();
+    mem->refs = 1;
+    mem->flags = flags;
+    mem->size = size;
+    mem->offset = 0;
+    mem->parent = NULL;
+    if (flags & CL_MEM_USE_HOST_PTR) {
+        mem->host = (char *)host_ptr;
+        mem->ownsHost = false;
+    } else {
+        mem->host = (char *)calloc(size, 1);
+        mem->ownsHost = true;
+    }
+    // A page aligned user pointer is used by the device directly (zero copy)
+    if ((flags & CL_MEM_USE_HOST_PTR) && ((uintptr_t)host_ptr % 4096) == 0) {
+        mem->device = mem->host;
+        mem->ownsDevice = false;
+    } else {
+        mem->device = (char *)calloc(size, 1);
+        mem->ownsDevice = true;
+    }
+    if (!mem->host || !mem->device) {
+        setError(errcode_ret, CL_MEM_OBJECT_ALLOCATION_FAILURE);
+        return NULL;
+    }
+    if (flags & CL_MEM_COPY_HOST_PTR) {
+        memcpy(mem->host, host_ptr, size);
+        memcpy(mem->device, host_ptr, size);
+    }
+    setError(errcode_ret, CL_SUCCESS);
+    return mem;
+}
+
+cl_mem clCreateSubBuffer(cl_mem buffer, cl_mem_flags flags, cl_buffer_create_type buffer_create_type,
+                         const void *buffer_create_info, cl_int *errcode_ret) {
+    if (!buffer || buffer->parent) {
+        setError(errcode_ret, CL_INVALID_MEM_OBJECT);
+        return NULL;
+    }
+    const cl_buffer_region *region = (const cl_buffer_region *)buffer_create_info;
+    if (buffer_create_type != CL_BUFFER_CREATE_TYPE_REGION || !region) {
+        setError(errcode_ret, CL_INVALID_VALUE);
+        return NULL;
+    }
+    if (region->size == 0) {
+        setError(errcode_ret, CL_INVALID_BUFFER_SIZE);
+        return NULL;
+    }
+    if (region->origin + region->size > buffer->size) {
+        setError(errcode_ret, CL_INVALID_VALUE);
+        return NULL;
+    }
+    if (region->origin % (envInt("CLMOCK_BASE_ADDR_ALIGN", 4096) / 8) != 0) {
+        setError(errcode_ret, CL_MISALIGNED_SUB_BUFFER_OFFSET);
+        return NULL;
+    }
+
+    cl_mem mem = new _cl_mem();
+    mem->refs = 1;
+    mem->flags = flags ? flags : buffer->flags;
+    mem->size = region->size;
+    mem->offset = region->origin;
+    mem->parent = buffer;
+    mem->host = buffer->host + region->origin;
+    mem->device = buffer->device + region->origin;
+    mem->ownsHost = false;
+    mem->ownsDevice = false;
+    buffer->refs++;
+    setError(errcode_ret, CL_SUCCESS);
+    return mem;
+}
+
+cl_int clGetMemObjectInfo(cl_mem memobj, cl_mem_info param_name, size_t param_value_size,
+                          void *param_value, size_t *param_value_size_ret) {
+    if (!memobj) {
+        return CL_INVALID_MEM_OBJECT;
+    }
+    switch (param_name) {
+    case CL_MEM_FLAGS:
+        return setInfo<cl_mem_flags>(memobj->flags, param_value_size, param_value, param_value_size_ret);
+    case CL_MEM_SIZE:
+        return setInfo<size_t>(memobj->size, param_value_size, param_value, param_value_size_ret);
+    case CL_MEM_HOST_PTR:
+        return setInfo<void *>((memobj->flags & CL_MEM_USE_HOST_PTR) ? memobj->host : NULL,
+                               param_value_size, param_value, param_value_size_ret);
+    case CL_MEM_OFFSET:
+        return setInfo<size_t>(memobj->offset, param_value_size, param_value, param_value_size_ret);
+    }
+    return CL_INVALID_VALUE;
+}
+
+cl_int clRetainMemObject(cl_mem memobj) {
+    if (!memobj) {
+        return CL_INVALID_MEM_OBJECT;
+    }
+    memobj->refs++;
+    return CL_SUCCESS;
+}
+
+cl_int clReleaseMemObject(cl_mem memobj) {
+    if (!memobj) {
+        return CL_INVALID_MEM_OBJECT;
+    }
+    if (--memobj->refs == 0) {
+        if (memobj->ownsHost) {
+            free(memobj->host);
+        }
+        if (memobj->ownsDevice) {
+            free(memobj->device);
+        }
+        if (memobj->parent) {
+            clReleaseMemObject(memobj->parent);
+        }
+        delete memobj;
+    }
+    return CL_SUCCESS;
+}
+
+//
+// Program and kernel
+//
+cl_program clCreateProgramWithBinary(cl_context context, cl_uint num_devices, const cl_device_id *device_list,
+                                     const size_t *, const unsigned char **binaries,
+                                     cl_int *binary_status, cl_int *errcode_ret) {
+    if (!context) {
+        setError(errcode_ret, CL_INVALID_CONTEXT);
+        return NULL;
+    }
+    if (num_devices != 1 || !device_list || device_list[0] != &theDevice) {
+        setError(errcode_ret, CL_INVALID_DEVICE);
+        return NULL;
+    }
+    if (!binaries || !binaries[0]) {
+        setError(errcode_ret, CL_INVALID_VALUE);
+        return NULL;
+    }
+    // The binary is not interpreted: kernels come from clmock_kernels[]
+    if (binary_status) {
+        binary_status[0] = CL_SUCCESS;
+    }
+    cl_program program = new _cl_program();
+    program->refs = 1;
+    setError(errcode_ret, CL_SUCCESS);
+    return program;
+}
+
+cl_program clCreateProgramWithSource(cl_context context, cl_uint count, const char **strings, const size_t *,
+                                     cl_int *errcode_ret) {
+    if (!context) {
+        setError(errcode_ret, CL_INVALID_CONTEXT);
+        return NULL;
+    }
+    if (count == 0 || !strings) {
+        setError(errcode_ret, CL_INVALID_VALUE);
+        return NULL;
+    }
+    cl_program program = new _cl_program();
+    program->refs = 1;
+    setError(errcode_ret, CL_SUCCESS);
+    return program;
+}
+
+cl_int clBuildProgram(cl_program program, cl_uint, const cl_device_id *, const char *,
+                      void (*pfn_notify)(cl_program, void *), void *user_data) {
+    if (!program) {
+        return CL_INVALID_PROGRAM;
+    }
+    if (pfn_notify) {
+        pfn_notify(program, user_data);
+    }
+    return CL_SUCCESS;
+}
+
+cl_int clGetProgramBuildInfo(cl_program program, cl_device_id, cl_program_build_info param_name,
+                             size_t param_value_size, void *param_value, size_t *param_value_size_ret) {
+    if (!program) {
+        return CL_INVALID_PROGRAM;
+    }
+    if (param_name == CL_PROGRAM_BUILD_LOG) {
+        return setInfoString("", param_value_size, param_value, param_value_size_ret);
+    }
+    return CL_INVALID_VALUE;
+}
+
+cl_int clReleaseProgram(cl_program program) {
+    if (!program) {
+        return CL_INVALID_PROGRAM;
+    }
+    if (--program->refs == 0) {
+        delete program;
+    }
+    return CL_SUCCESS;
+}
+
+cl_kernel clCreateKernel(cl_program program, const char *kernel_name, cl_int *errcode_ret) {
+    if (!program) {
+        setError(errcode_ret, CL_INVALID_PROGRAM);
+        return NULL;
+    }
+    const clmock_kernel *def = kernel_name ? findKernel(kernel_name) : NULL;
+    if (!def) {
+        setError(errcode_ret, CL_INVALID_KERNEL_NAME);
+        return NULL;
+    }
+    cl_kernel kernel = new _cl_kernel();
+    kernel->refs = 1;
+    kernel->def = def;
+    kernel->args.resize(strlen(def->arg_types));
+    kernel->argSet.resize(strlen(def->arg_types), false);
+    setError(errcode_ret, CL_SUCCESS);
+    return kernel;
+}
+
+cl_int clSetKernelArg(cl_kernel kernel, cl_uint arg_index, size_t arg_size, const void *arg_value) {
+    if (!kernel) {
+        return CL_INVALID_KERNEL;
+    }
+    if (arg_index >= kernel->args.size()) {
+        return CL_INVALID_ARG_INDEX;
+    }
+    if (kernel->def->arg_types[arg_index] == 'm') {
+        if (arg_size != sizeof(cl_mem)) {
+            return CL_INVALID_ARG_SIZE;
+        }
+        if (arg_value && *(const cl_mem *)arg_value == NULL) {
+            return CL_INVALID_MEM_OBJECT;
+        }
+    }
+    if (!arg_value || arg_size == 0) {
+        return CL_INVALID_ARG_VALUE;
+    }
+    kernel->args[arg_index].assign((const char *)arg_value, (const char *)arg_value + arg_size);
+    kernel->argSet[arg_index] = true;
+    return CL_SUCCESS;
+}
+
+cl_int clGetKernelInfo(cl_kernel kernel, cl_kernel_info param_name, size_t param_value_size,
+                       void *param_value, size_t *param_value_size_ret) {
+    if (!kernel) {
+        return CL_INVALID_KERNEL;
+    }
+    switch (param_name) {
+    case CL_KERNEL_FUNCTION_NAME:
+        return setInfoString(kernel->def->name, param_value_size, param_value, param_value_size_ret);
+    case CL_KERNEL_NUM_ARGS:
+        return setInfo<cl_uint>(kernel->args.size(), param_value_size, param_value, param_value_size_ret);
+    case CL_KERNEL_COMPUTE_UNIT_COUNT:
+        return setInfo<cl_uint>(computeUnits(), param_value_size, param_value, param_value_size_ret);
+    }
+    return CL_INVALID_VALUE;
+}
+
+cl_int clReleaseKernel(cl_kernel kernel) {
+    if (!kernel) {
+        return CL_INVALID_KERNEL;
+    }
+    if (--kernel->refs == 0) {
+        delete kernel;
+    }
+    return CL_SUCCESS;
+}
+
+//
+// Events
+//
+cl_int clWaitForEvents(cl_uint num_events, const cl_event *event_list) {
+    if (num_events == 0 || !event_list) {
+        return CL_INVALID_VALUE;
+    }
+    for (cl_uint i = 0; i < num_events; i++) {
+        if (!event_list[i]) {
+            return CL_INVALID_EVENT;
+        }
+    }
+    theScheduler.wait(num_events, event_list);
+    return CL_SUCCESS;
+}
+
+cl_int clGetEventInfo(cl_event event, cl_event_info param_name, size_t param_value_size, void *param_value,
+                      size_t *param_value_size_ret) {
+    if (!event) {
+        return CL_INVALID_EVENT;
+    }
+    switch (param_name) {
+    case CL_EVENT_COMMAND_TYPE:
+        return setInfo<cl_command_type>(event->type, param_value_size, param_value, param_value_size_ret);
+    case CL_EVENT_COMMAND_EXECUTION_STATUS:
+        return setInfo<cl_int>(theScheduler.status(event), param_value_size, param_value,
+                               param_value_size_ret);
+    }
+    return CL_INVALID_VALUE;
+}
+
+cl_int clGetEventProfilingInfo(cl_event event, cl_profiling_info param_name, size_t param_value_size,
+                               void *param_value, size_t *param_value_size_ret) {
+    if (!event) {
+        return CL_INVALID_EVENT;
+    }
+    if (!(event->queue->properties & CL_QUEUE_PROFILING_ENABLE) ||
+        theScheduler.status(event) != CL_COMPLETE) {
+        return CL_PROFILING_INFO_NOT_AVAILABLE;
+    }
+    switch (param_name) {
+    case CL_PROFILING_COMMAND_QUEUED:
+        return setInfo<cl_ulong>(event->queued, param_value_size, param_value, param_value_size_ret);
+    case CL_PROFILING_COMMAND_SUBMIT:
+        return setInfo<cl_ulong>(event->submit, param_value_size, param_value, param_value_size_ret);
+    case CL_PROFILING_COMMAND_START:
+        return setInfo<cl_ulong>(event->start, param_value_size, param_value, param_value_size_ret);
+    case CL_PROFILING_COMMAND_END:
+        return setInfo<cl_ulong>(event->end, param_value_size, param_value, param_value_size_ret);
+    }
+    return CL_INVALID_VALUE;
+}
+
+cl_int clSetEventCallback(cl_event event, cl_int command_exec_callback_type,
+                          void (*pfn_notify)(cl_event, cl_int, void *), void *user_data) {
+    if (!event) {
+        return CL_INVALID_EVENT;
+    }
+    if (!pfn_notify || command_exec_callback_type != CL_COMPLETE) {
+        return CL_INVALID_VALUE;
+    }
+    if (!theScheduler.addCallback(event, pfn_notify, user_data)) {
+        pfn_notify(event, CL_COMPLETE, user_data);
+    }
+    return CL_SUCCESS;
+}
+
+cl_int clRetainEvent(cl_event event) {
+    if (!event) {
+        return CL_INVALID_EVENT;
+    }
+    event->refs++;
+    return CL_SUCCESS;
+}
+
+cl_int clReleaseEvent(cl_event event) {
+    if (!event) {
+        return CL_INVALID_EVENT;
+    }
+    releaseEvent(event);
+    return CL_SUCCESS;
+}
+
+//
+// Enqueued commands
+//
+cl_int clEnqueueMigrateMemObjects(cl_command_queue command_queue, cl_uint num_mem_objects,
+                                  const cl_mem *mem_objects, cl_mem_migration_flags flags,
+                                  cl_uint num_events_in_wait_list, const cl_event *event_wait_list,
+                                  cl_event *event) {
+    if (!command_queue) {
+        return CL_INVALID_COMMAND_QUEUE;
+    }
+    if (num_mem_objects == 0 || !mem_objects) {
+        return CL_INVALID_VALUE;
+    }
+    for (cl_uint i = 0; i < num_mem_objects; i++) {
+        if (!mem_objects[i]) {
+            return CL_INVALID_MEM_OBJECT;
+        }
+    }
+    cl_int err = checkWaitList(num_events_in_wait_list, event_wait_list);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    std::vector<cl_mem> mems(mem_objects, mem_objects + num_mem_objects);
+    cl_event created = theScheduler.submit(
+        command_queue, CL_COMMAND_MIGRATE_MEM_OBJECTS, ENGINE_DMA, num_events_in_wait_list,
+        event_wait_list, [mems, flags]() {
+            for (size_t i = 0; i < mems.size(); i++) {
+                if (mems[i]->host == mems[i]->device ||
+                    (flags & CL_MIGRATE_MEM_OBJECT_CONTENT_UNDEFINED)) {
+                    continue;
+                }
+                if (flags & CL_MIGRATE_MEM_OBJECT_HOST) {
+                    memcpy(mems[i]->host, mems[i]->device, mems[i]->size);
+                } else {
+                    memcpy(mems[i]->device, mems[i]->host, mems[i]->size);
+                }
+            }
+        });
+    returnEvent(created, event);
+    return CL_SUCCESS;
+}
+
+cl_int clEnqueueReadBuffer(cl_command_queue command_queue, cl_mem buffer, cl_bool blocking_read,
+                           size_t offset, size_t size, void *ptr, cl_uint num_events_in_wait_list,
+                           const cl_event *event_wait_list, cl_event *event) {
+    if (!command_queue) {
+        return CL_INVALID_COMMAND_QUEUE;
+    }
+    if (!buffer) {
+        return CL_INVALID_MEM_OBJECT;
+    }
+    if (!ptr || offset + size > buffer->size) {
+        return CL_INVALID_VALUE;
+    }
+    cl_int err = checkWaitList(num_events_in_wait_list, event_wait_list);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    cl_event created = theScheduler.submit(
+        command_queue, CL_COMMAND_READ_BUFFER, ENGINE_DMA, num_events_in_wait_list, event_wait_list,
+        [buffer, offset, size, ptr]() { memcpy(ptr, buffer->device + offset, size); });
+    if (blocking_read) {
+        theScheduler.wait(1, &created);
+    }
+    returnEvent(created, event);
+    return CL_SUCCESS;
+}
+
+cl_int clEnqueueWriteBuffer(cl_command_queue command_queue, cl_mem buffer, cl_bool blocking_write,
+                            size_t offset, size_t size, const void *ptr, cl_uint num_events_in_wait_list,
+                            const cl_event *event_wait_list, cl_event *event) {
+    if (!command_queue) {
+        return CL_INVALID_COMMAND_QUEUE;
+    }
+    if (!buffer) {
+        return CL_INVALID_MEM_OBJECT;
+    }
+    if (!ptr || offset + size > buffer->size) {
+        return CL_INVALID_VALUE;
+    }
+    cl_int err = checkWaitList(num_events_in_wait_list, event_wait_list);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    cl_event created = theScheduler.submit(
+        command_queue, CL_COMMAND_WRITE_BUFFER, ENGINE_DMA, num_events_in_wait_list, event_wait_list,
+        [buffer, offset, size, ptr]() { memcpy(buffer->device + offset, ptr, size); });
+    if (blocking_write) {
+        theScheduler.wait(1, &created);
+    }
+    returnEvent(created, event);
+    return CL_SUCCESS;
+}
+
+void *clEnqueueMapBuffer(cl_command_queue command_queue, cl_mem buffer, cl_bool blocking_map, cl_map_flags,
+                         size_t offset, size_t size, cl_uint num_events_in_wait_list,
+                         const cl_event *event_wait_list, cl_event *event, cl_int *errcode_ret) {
+    if (!command_queue) {
+        setError(errcode_ret, CL_INVALID_COMMAND_QUEUE);
+        return NULL;
+    }
+    if (!buffer) {
+        setError(errcode_ret, CL_INVALID_MEM_OBJECT);
+        return NULL;
+    }
+    if (offset + size > buffer->size) {
+        setError(errcode_ret, CL_INVALID_VALUE);
+        return NULL;
+    }
+    cl_int err = checkWaitList(num_events_in_wait_list, event_wait_list);
+    if (err != CL_SUCCESS) {
+        setError(errcode_ret, err);
+        return NULL;
+    }
+    // The host copy is always mapped, mapping only orders the command
+    cl_event created = theScheduler.submit(command_queue, CL_COMMAND_MAP_BUFFER, ENGINE_NONE,
+                                           num_events_in_wait_list, event_wait_list, []() {});
+    if (blocking_map) {
+        theScheduler.wait(1, &created);
+    }
+    returnEvent(created, event);
+    setError(errcode_ret, CL_SUCCESS);
+    return buffer->host + offset;
+}
+
+cl_int clEnqueueUnmapMemObject(cl_command_queue command_queue, cl_mem memobj, void *mapped_ptr,
+                               cl_uint num_events_in_wait_list, const cl_event *event_wait_list,
+                               cl_event *event) {
+    if (!command_queue) {
+        return CL_INVALID_COMMAND_QUEUE;
+    }
+    if (!memobj) {
+        return CL_INVALID_MEM_OBJECT;
+    }
+    if ((char *)mapped_ptr < memobj->host || (char *)mapped_ptr >= memobj->host + memobj->size) {
+        return CL_INVALID_VALUE;
+    }
+    cl_int err = checkWaitList(num_events_in_wait_list, event_wait_list);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    cl_event created = theScheduler.submit(command_queue, CL_COMMAND_UNMAP_MEM_OBJECT, ENGINE_NONE,
+                                           num_events_in_wait_list, event_wait_list, []() {});
+    returnEvent(created, event);
+    return CL_SUCCESS;
+}
+
+cl_int clEnqueueTask(cl_command_queue command_queue, cl_kernel kernel, cl_uint num_events_in_wait_list,
+                     const cl_event *event_wait_list, cl_event *event) {
+    if (!command_queue) {
+        return CL_INVALID_COMMAND_QUEUE;
+    }
+    if (!kernel) {
+        return CL_INVALID_KERNEL;
+    }
+    for (size_t i = 0; i < kernel->argSet.size(); i++) {
+        if (!kernel->argSet[i]) {
+            return CL_INVALID_KERNEL_ARGS;
+        }
+    }
+    cl_int err = checkWaitList(num_events_in_wait_list, event_wait_list);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    // Arguments are captured now, the kernel may be reused right away
+    const clmock_kernel *def = kernel->def;
+    std::vector<std::vector<char> > args = kernel->args;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (def->arg_types[i] == 'm') {
+            (*(cl_mem *)args[i].data())->refs++;
+        }
+    }
+    cl_event created = theScheduler.submit(
+        command_queue, CL_COMMAND_TASK, ENGINE_CU, num_events_in_wait_list, event_wait_list, [def, args]() {
+            std::vector<void *> values(args.size());
+            for (size_t i = 0; i < args.size(); i++) {
+                if (def->arg_types[i] == 'm') {
+                    values[i] = (*(const cl_mem *)args[i].data())->device;
+                } else {
+                    values[i] = (void *)args[i].data();
+                }
+            }
+            def->run(values.data());
+            for (size_t i = 0; i < args.size(); i++) {
+                if (def->arg_types[i] == 'm') {
+                    clReleaseMemObject(*(const cl_mem *)args[i].data());
+                }
+            }
+        });
+    returnEvent(created, event);
+    return CL_SUCCESS;
+}
+
+cl_int clEnqueueMarkerWithWaitList(cl_command_queue command_queue, cl_uint num_events_in_wait_list,
+                                   const cl_event *event_wait_list, cl_event *event) {
+    if (!command_queue) {
+        return CL_INVALID_COMMAND_QUEUE;
+    }
+    cl_int err = checkWaitList(num_events_in_wait_list, event_wait_list);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    cl_event created = theScheduler.submit(command_queue, CL_COMMAND_MARKER, ENGINE_NONE,
+                                           num_events_in_wait_list, event_wait_list, []() {});
+    returnEvent(created, event);
+    return CL_SUCCESS;
+}
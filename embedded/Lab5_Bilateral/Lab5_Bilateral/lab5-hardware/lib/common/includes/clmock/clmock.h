@@ -0,0 +1,35 @@
+/**********
+Mock OpenCL runtime - kernel registration.
+
+The mock runtime (clmock.cpp) executes clEnqueueTask by calling a C++
+function compiled for the host CPU. Every application that links the mock
+defines the table below, one entry per kernel name of its xclbin.
+**********/
+#ifndef _CLMOCK_H_
+#define _CLMOCK_H_
+
+#include <CL/cl.h>
+
+/*
+ * A kernel that the mock device can run.
+ *  name:      Kernel name, as given to clCreateKernel (without the
+ *             ":{instance}" compute unit suffix).
+ *  arg_types: One character per argument: 'm' for a cl_mem buffer,
+ *             which the kernel receives as a pointer to the device
+ *             copy, 's' for a scalar passed by value.
+ *  run:       Calls the kernel. args[i] is the device pointer of a
+ *             buffer argument, or points to the bytes of a scalar.
+ */
+struct clmock_kernel {
+    const char *name;
+    const char *arg_types;
+    void (*run)(void *const *args);
+};
+
+// Reads scalar argument i of the args array given to run()
+#define CLMOCK_SCALAR(type, args, i) (*(const type *)(args)[i])
+
+// Kernel table of the application, terminated by an entry with a NULL name
+extern const clmock_kernel clmock_kernels[];
+
+#endif
@@ -0,0 +1,4 @@
+clmock_SRCS:=${COMMON_REPO}/common/includes/clmock/clmock.cpp
+clmock_HDRS:=${COMMON_REPO}/common/includes/clmock/clmock.h ${COMMON_REPO}/common/includes/clmock/CL/cl.h
+clmock_CXXFLAGS:=-I${COMMON_REPO}/common/includes/clmock -pthread
+clmock_LDFLAGS:=-pthread
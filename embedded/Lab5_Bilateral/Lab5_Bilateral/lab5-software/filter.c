@@ -1,183 +1,308 @@
 #include <stdio.h>
-#include <math.h>
 #include <stdlib.h>
-#include "time.h"
-
-#define SIZE_X 320 // Input image Width
-#define SIZE_Y 240 // Input image Height
-#define FILTER_SIZE 5 // Filter size
-#define FILTER_RADIUS 2 // Filter radius
-
-// Utilty Macros
-#define MIN(a,b) (((a)<(b))?(a):(b))
-#define MAX(a,b) (((a)>(b))?(a):(b))
+#include <string.h>
+#include <math.h>
+#include "filterCommon.h"
+#include "filterBackend.h"
+#include "filterTrace.h"
+#include "filterPerf.h"
+#include "filterStats.h"
 
-struct timespec tick_clockData;
-struct timespec tock_clockData;
+#define FRAMES 1 // Default number of frames filtered
+#define BACKEND "openmp" // Default backend
+#define EXACT_MSE 1e-6 // Largest MSE of a backend that computes the golden output
 
-#define TICK()    { clock_gettime(CLOCK_MONOTONIC, &tick_clockData);}
-#define TOCK(str) { clock_gettime(CLOCK_MONOTONIC, &tock_clockData);\
-                    printf("%s\t %f milliseconds\n",str,\
-                    (((double) tock_clockData.tv_sec + tock_clockData.tv_nsec / 1000000000.0) - \
-                    ((double) tick_clockData.tv_sec + tick_clockData.tv_nsec / 1000000000.0))\
-                    * 1000);}
+// Backends built into this executable
+static const filter_backend *backends[] = {
+    &scalar_backend,
+    &simd_backend,
+    &openmp_backend,
+    &pruned_backend,
+    &recursive_backend,
+    &lattice_backend,
+    &flat_backend,
+    &temporal_backend,
+#ifdef FPGA_BACKEND
+    &fpga_backend,
+#endif
+    NULL
+};
 
-// Input Array
+// Input Array, frames packed back to back
 float *input;
+// Frames the input file holds, repeated to the frames filtered
+int input_frames;
+// Input frames as uint16 depth (u16 format)
+uint16_t *depth_input;
+// Non zero to filter depth_input instead of input
+int use_depth;
 // Output Array
 float *output;
 // Filter Vector
-float *gaussian;
+float gaussian[FILTER_SIZE];
 
 /***********************************************************
- * Function:  bilateralFilterKernel
+ * Function:  find_backend
  * ---------------------------------------------------------
- * Applies a vector filter on a SIZE_X x SIZE_Y input image.
- *
- *                           Apply
- *    +--------------+     +--------+    +--------------+
- *    |              |     |        |    |              |
- *    | Input Image  +---->+ Filter +--->+ Output Image |
- *    |              |     |        |    |              |
- *    +--------------+     +--------+    +--------------+
- *
- *
- *  out: The output image after the filter was applied.
- *
- *  in: The input image.
- *
- *  gaussian: A 5 element vector that holds the filter values.
- *************************************************************/
-void bilateralFilterKernel(float* out, const float* in,const float * gaussian, int size_x, int size_y, int r) {
-        // Local Variables
-        int i,j;
-		unsigned int x,y,pos;
-
-        #pragma omp parallel for shared(out),private(y,i,j,x,pos) schedule(static)
-		for (y = 0; y < size_y; y++) {
-			for (x = 0; x < size_x; x++) {
-				pos = x + y * size_x;
-				if (in[pos] == 0) {
-					out[pos] = 0;
-					continue;
-				}
-
-				float sum = 0.0f;
-				float t = 0.0f;
-
-				const float center = in[pos];
-
-				for (i = -r; i <= r; ++i) {
-					for (j = -r; j <= r; ++j) {
-						unsigned int curPos_x = MAX(0u, MIN(x + i,size_x - 1));
-                        unsigned int curPos_y = MAX(0u, MIN(y + j,size_y - 1));
-
-						const float curPix = in[curPos_x + curPos_y * size_x];
-						if (curPix > 0) {
-							const float mod = pow(curPix - center,2);
-							const float factor = gaussian[i + r]
-									* gaussian[j + r]
-									* expf(-mod / 0.02f);
-							t += factor * curPix;
-							sum += factor;
-						}
-					}
-				}
-				out[pos] = t / sum;
-			}
-		}
+ * Returns the backend called name, or NULL.
+ * *********************************************************/
+const filter_backend *find_backend(const char *name){
+    int b;
+
+    for (b = 0; backends[b]; b++) {
+        if (strcmp(backends[b]->name, name) == 0) {
+            return backends[b];
+        }
+    }
+    return NULL;
 }
 
 /***********************************************************
- * Function:  read_input
+ * Function:  run_filter
  * ---------------------------------------------------------
- * Reads the input.bin file, and loads it to input array.
+ * Filters frames of the input format with backend. Returns
+ * 0 on success, -1 if the backend failed or does not take
+ * the format.
  * *********************************************************/
-void read_input(){
-    FILE *fptr;
-
-    if ((fptr = fopen("input.bin","r")) == NULL){
-        printf("Error! opening file");
-        exit(1);
+int run_filter(const filter_backend *backend, int frames){
+    if (use_depth) {
+        if (!backend->filter_u16) {
+            return -1;
+        }
+        return backend->filter_u16(output, depth_input, gaussian, SIZE_X, SIZE_Y, FILTER_RADIUS, frames);
+    }
+    if (!backend->filter) {
+        return -1;
     }
+    return backend->filter(output, input, gaussian, SIZE_X, SIZE_Y, FILTER_RADIUS, frames);
+}
+
+/***********************************************************
+ * Function:  flicker
+ * ---------------------------------------------------------
+ * Root mean square change, in millimetres, of the pixels
+ * valid in two consecutive output frames, the frame to
+ * frame noise left. Changes of FILTER_SIGMA_R or more are
+ * moving edges, not noise, and are left out.
+ * *********************************************************/
+double flicker(const float *frames, int count){
+    double sum = 0.0, diff;
+    long i, valid = 0;
+    int f;
 
-    fread(input, sizeof(float) * SIZE_X * SIZE_Y, 1, fptr);
-    fclose(fptr);
+    for (f = 1; f < count; f++) {
+        const float *cur = frames + (long) f * SIZE_X * SIZE_Y;
+        const float *prev = cur - SIZE_X * SIZE_Y;
 
+        for (i = 0; i < SIZE_X * SIZE_Y; i++) {
+            diff = cur[i] - prev[i];
+            if (cur[i] != 0 && prev[i] != 0 && fabs(diff) < FILTER_SIGMA_R) {
+                sum += diff * diff;
+                valid++;
+            }
+        }
+    }
+    return valid ? sqrt(sum / valid) * DEPTH_UNITS : 0.0;
 }
 
 /***********************************************************
- * Function:  compare
+ * Function:  benchmark
  * ---------------------------------------------------------
- * Reads the output.bin file, that contains the golden output
- * values. Then it compares it with the filter output array by
- * calculating the Mean Error Square (MSE). The perfect solution
- * must have an MSE value of 0. A greater value corresponds to
- * a worse solution.
+ * Filters all frames with one backend, after a warm up run
+ * on the first frame that absorbs one time costs (thread
+ * start, first kernel launch). Checks the first and last
+ * frame. Returns the milliseconds per frame and the worse
+ * MSE of the two, or a negative time if the backend is not
+ * available or failed. The first frame alone would pass
+ * the temporal backend, whose first window is one frame.
  * *********************************************************/
-void compare(){
-    FILE *fptr;
-    int y,x;
-    double diff;
-    double mse=-0.068993; // A calculated constant - DO NOT CHANGE IT.
-
-    // Open output file and load it to outputGolden
-    if ((fptr = fopen("goldenOutput.bin","r")) == NULL){
-            printf("Error! opening file");
-            exit(1);
-    }
-    float *goldenOutput = (float*) malloc(sizeof(float) * SIZE_X * SIZE_Y);
-    fread(goldenOutput, sizeof(float) * SIZE_X * SIZE_Y, 1, fptr);
-    fclose(fptr);
-
-    // Calculate MSR
-    for ( x = 0; x < SIZE_X; x++) {
-        for (y = 0; y < SIZE_Y; y++){
-            diff = output[x + y * SIZE_X] - goldenOutput[x + y *SIZE_X];
-            mse += pow(fabs(diff),2.0);
-        }
+double benchmark(const filter_backend *backend, int frames, const char *xclbin, double *mse){
+    double ms, last_mse;
+
+    printf("--------- %s --------------\n", backend->name);
+    if (use_depth ? !backend->filter_u16 : !backend->filter) {
+        printf("%s: no %s input\n", backend->name, use_depth ? "u16" : "f32");
+        return -1.0;
+    }
+    if (backend->open(xclbin) != 0) {
+        printf("%s: not available\n", backend->name);
+        return -1.0;
+    }
+    if (run_filter(backend, 1) != 0) {
+        printf("%s: filter failed\n", backend->name);
+        backend->close();
+        return -1.0;
     }
-    printf("MSE :\t\t %.6f\n", mse/(double)(SIZE_X*SIZE_Y));
+    perf_reset();
+#ifdef FILTER_STATS
+    stats_reset();
+#endif
+    trace_begin(backend->name);
+    perf_begin(PERF_FILTER);
+    if (run_filter(backend, frames) != 0) {
+        perf_end(PERF_FILTER, 0);
+        trace_end();
+        printf("%s: filter failed\n", backend->name);
+        backend->close();
+        return -1.0;
+    }
+    perf_end(PERF_FILTER, (long) SIZE_X * SIZE_Y * frames);
+    ms = trace_end() / frames;
+    backend->close();
+    perf_report();
+#ifdef FILTER_STATS
+    stats_report();
+#endif
 
-    free(goldenOutput);
+    *mse = compare(output);
+    if (frames > 1) {
+        last_mse = compare_frame(output + (frames - 1) * SIZE_X * SIZE_Y, (frames - 1) % input_frames);
+        if (last_mse > *mse) {
+            *mse = last_mse;
+        }
+    }
+    return ms;
 }
 
 /***********************************************************
- * Function:  compare
+ * Function:  main
  * ---------------------------------------------------------
- * Main function.
+ * Runs one backend, or benchmarks all of them on the same
+ * frames with "all" and names the fastest exact one, that
+ * gives the golden output; approximations (recursive,
+ * lattice, temporal) are only timed and their MSE
+ * reported, even where the input lets them match it. The
+ * flat and pruned backends count as exact while their
+ * error stays under EXACT_MSE. The change of every MSE
+ * from the one of the first backend, the reference filter,
+ * shows errors below the print precision of compare(). An
+ * input file of several frames, e.g. from filterGen
+ * frames=<N>, is filtered as a video, repeated to the
+ * frames asked for, and the frame to frame flicker of the
+ * output is reported with the throughput. With u16 the
+ * frames are given as uint16 millimetres, as depth cameras
+ * deliver them, and converted by the backends as they read
+ * them. An xclbin of "-" stands for none. FILTER_TRACE
+ * names a file to write a trace of the run to, FILTER_PERF
+ * turns the performance counters of filterPerf.h on.
  * *********************************************************/
 int main(int argc, char *argv[]){
-    int i,x;
+    const char *name = BACKEND;
+    const char *xclbin = NULL;
+    const filter_backend *backend, *fastest = NULL;
+    int frames = FRAMES;
+    int f, b, i;
+    double ms, best = 0, mse, reference_mse = 0;
+
+    if (argc > 1) {
+        name = argv[1];
+    }
+    if (argc > 2) {
+        frames = atoi(argv[2]);
+    }
+    if (argc > 3 && strcmp(argv[3], "-") != 0) {
+        xclbin = argv[3];
+    }
+    if (argc > 4) {
+        use_depth = strcmp(argv[4], "u16") == 0;
+    }
+    if (frames < 1) {
+        printf("Error: frames must be positive\n");
+        return EXIT_FAILURE;
+    }
+    backend = find_backend(name);
+    if ((!backend && strcmp(name, "all") != 0) || (argc > 4 && !use_depth && strcmp(argv[4], "f32") != 0)) {
+        printf("Usage: %s [backend|all] [frames] [xclbin|-] [f32|u16]\nBackends:", argv[0]);
+        for (b = 0; backends[b]; b++) {
+            printf(" %s", backends[b]->name);
+        }
+        printf("\n");
+        return EXIT_FAILURE;
+    }
 
     // Allocate memory for data arrays
-    input = (float*) calloc(sizeof(float) * SIZE_X * SIZE_Y,1);
-    output = (float*) calloc(sizeof(float) * SIZE_X * SIZE_Y,1);
-    gaussian = (float*) calloc(FILTER_SIZE * sizeof(float), 1);
+    input = (float*) frame_alloc(sizeof(float) * SIZE_X * SIZE_Y * frames);
+    output = (float*) frame_alloc(sizeof(float) * SIZE_X * SIZE_Y * frames);
 
     printf("--------- Running --------------\n");
+    trace_start(getenv("FILTER_TRACE"));
+    perf_start();
+#ifdef FILTER_STATS
+    stats_start(SIZE_X, SIZE_Y);
+#endif
 
-    TICK();
-    read_input();
-
-    /**** Create filter vector using a mathematical expression *****/
-     for (i= 0; i < FILTER_SIZE; i++) {
-		x = i - 2;
-		gaussian[i] = expf(-(x * x) / (32.0f));
-	}
-
-    TOCK("load_time:");
+    trace_begin("load");
+    perf_begin(PERF_LOAD);
+    input_frames = read_frames(input, frames);
+    for (f = input_frames; f < frames; f++) {
+        memcpy(input + f * SIZE_X * SIZE_Y, input + (f % input_frames) * SIZE_X * SIZE_Y,
+               sizeof(float) * SIZE_X * SIZE_Y);
+    }
+    make_gaussian(gaussian);
+    if (use_depth) {
+        depth_input = (uint16_t*) frame_alloc(sizeof(uint16_t) * SIZE_X * SIZE_Y * frames);
+        for (i = 0; i < SIZE_X * SIZE_Y * frames; i++) {
+            depth_input[i] = depth_from_float(input[i]);
+        }
+    }
+    perf_end(PERF_LOAD, (long) SIZE_X * SIZE_Y * frames);
+    printf("load_time:\t%f milliseconds\t%d input frames\n", trace_end(), input_frames);
 
-    TICK();
-    bilateralFilterKernel(output, input, gaussian, SIZE_X, SIZE_Y,FILTER_RADIUS);
-    TOCK("filter_time:");
+    if (backend) {
+        if (backend->open(xclbin) != 0) {
+            printf("Error: backend %s is not available\n", name);
+            return EXIT_FAILURE;
+        }
+        trace_begin("filter");
+        perf_begin(PERF_FILTER);
+        if (run_filter(backend, frames) != 0) {
+            printf("Error: backend %s failed\n", name);
+            return EXIT_FAILURE;
+        }
+        perf_end(PERF_FILTER, (long) SIZE_X * SIZE_Y * frames);
+        ms = trace_end();
+        printf("filter_time:\t%f milliseconds\t%.1f fps\n", ms, 1000.0 * frames / ms);
+        if (input_frames > 1) {
+            printf("flicker:\t%.3f mm\n", flicker(output, MIN(frames, input_frames)));
+        }
+        backend->close();
 
-    TICK();
-    compare();
-    TOCK("compare_time:");
+        trace_begin("compare");
+        perf_begin(PERF_COMPARE);
+        compare(output);
+        perf_end(PERF_COMPARE, (long) SIZE_X * SIZE_Y);
+        printf("compare_time:\t%f milliseconds\n", trace_end());
+        perf_report();
+#ifdef FILTER_STATS
+        stats_report();
+#endif
+    } else {
+        for (b = 0; backends[b]; b++) {
+            ms = benchmark(backends[b], frames, xclbin, &mse);
+            if (ms >= 0) {
+                if (b == 0) {
+                    reference_mse = mse;
+                }
+                printf("%s:\t%.3f ms/frame\t%.1f fps\tMSE %.6f\tchange %+.3e", backends[b]->name, ms,
+                       1000.0 / ms, mse, mse - reference_mse);
+                if (input_frames > 1) {
+                    printf("\tflicker %.3f mm", flicker(output, MIN(frames, input_frames)));
+                }
+                printf("\n");
+                if (backends[b]->exact && mse < EXACT_MSE && (!fastest || ms < best)) {
+                    fastest = backends[b];
+                    best = ms;
+                }
+            }
+        }
+        if (fastest) {
+            printf("fastest:\t%s\t%.3f ms/frame\n", fastest->name, best);
+        }
+    }
 
+    trace_stop();
     free(input);
+    free(depth_input);
     free(output);
-    free(gaussian);
     return 0;
 }
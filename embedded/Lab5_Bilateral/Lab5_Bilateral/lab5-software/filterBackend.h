@@ -0,0 +1,69 @@
+#ifndef _FILTER_BACKEND_H_
+#define _FILTER_BACKEND_H_
+
+/***********************************************************
+ * Filter engines behind one interface, so that a single
+ * driver (filter.c) can run and benchmark any of them on
+ * the same frames. All but the recursive, lattice and
+ * temporal ones compute the golden output, the flat and
+ * pruned ones within their error bound.
+ *
+ * The CPU backends (filterCpu.c) are always built. The
+ * FPGA backend (lab5-hardware/filterBackendFpga.cpp) runs
+ * the xclbin through OpenCL; built with TARGET=mock it runs
+ * the HLS kernel on the mock device and is named "mock".
+ * *********************************************************/
+
+#include <stdint.h>
+
+/**
+ * A backend.
+ *  name:   Name given on the command line.
+ *  open:   Sets the engine up, once before the first filter
+ *          call. xclbin may be NULL for the CPU backends.
+ *          Returns 0 if the engine is available.
+ *  filter: Applies the filter on frames size_x x size_y
+ *          frames, packed back to back in in and out.
+ *          Returns 0 on success. NULL if the engine only
+ *          takes uint16 frames.
+ *  filter_u16: filter on uint16 depth frames (DEPTH_UNITS
+ *          per metre), converted to float as they are
+ *          filtered. NULL if the engine only takes float
+ *          frames.
+ *  close:  Releases the engine.
+ *  exact:  1 if the engine computes the golden output, so
+ *          that "all" may name it the fastest; 0 for the
+ *          approximations, whatever MSE they reach.
+ * */
+typedef struct {
+    const char *name;
+    int (*open)(const char *xclbin);
+    int (*filter)(float *out, const float *in, const float *gaussian, int size_x, int size_y, int r, int frames);
+    int (*filter_u16)(float *out, const uint16_t *in, const float *gaussian, int size_x, int size_y, int r,
+                      int frames);
+    void (*close)(void);
+    int exact;
+} filter_backend;
+
+// One thread, one pixel at a time
+extern const filter_backend scalar_backend;
+// One thread, SIMD_WIDTH pixels at a time
+extern const filter_backend simd_backend;
+// Rows shared between the OpenMP threads
+extern const filter_backend openmp_backend;
+// simd without the taps beyond a range cutoff (FILTER_CUTOFF)
+extern const filter_backend pruned_backend;
+// Recursive approximation, O(1) per pixel in the radius (filterRecursive.c)
+extern const filter_backend recursive_backend;
+// Permutohedral lattice, every frame its own guide (filterLattice.c)
+extern const filter_backend lattice_backend;
+// Separable Gaussian on flat tiles, within an error budget (filterFlat.c)
+extern const filter_backend flat_backend;
+// Spatio-temporal, over the previous frames of a ring buffer (filterTemporal.c)
+extern const filter_backend temporal_backend;
+#ifdef FPGA_BACKEND
+// Kernel of the xclbin, one row band per compute unit
+extern const filter_backend fpga_backend;
+#endif
+
+#endif
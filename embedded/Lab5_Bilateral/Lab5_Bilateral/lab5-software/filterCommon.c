@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "filterCommon.h"
+
+/***********************************************************
+ * Function:  read_frames
+ * ---------------------------------------------------------
+ * Reads up to count frames of the input.bin file, or of the
+ * one FILTER_INPUT names, into frames, and returns how many
+ * it held. A file smaller than a frame was written for
+ * another image size.
+ * *********************************************************/
+int read_frames(float *frames, int count){
+    FILE *fptr;
+    const char *path = getenv("FILTER_INPUT");
+    size_t read;
+
+    if (!path) {
+        path = INPUT_FILE;
+    }
+
+    /**** Load Input image ****/
+    if ((fptr = fopen(path,"r")) == NULL){
+        printf("Error! opening file %s\n", path);
+        exit(1);
+    }
+    read = fread(frames, sizeof(float) * SIZE_X * SIZE_Y, count, fptr);
+    if (read < 1) {
+        printf("Error: %s holds less than one %dx%d frame\n", path, SIZE_X, SIZE_Y);
+        exit(1);
+    }
+    fclose(fptr);
+    return (int) read;
+}
+
+/***********************************************************
+ * Function:  read_input
+ * ---------------------------------------------------------
+ * Loads the first frame of the input file to frame.
+ * *********************************************************/
+void read_input(float *frame){
+    read_frames(frame, 1);
+}
+
+/***********************************************************
+ * Function:  read_floats
+ * ---------------------------------------------------------
+ * Reads count floats of path into data, for the tools that
+ * take files of any size (guides, other resolutions).
+ * Returns 0 on success, -1 if the file is missing or short.
+ * *********************************************************/
+int read_floats(const char *path, float *data, long count){
+    FILE *fptr;
+    size_t read;
+
+    if ((fptr = fopen(path, "rb")) == NULL) {
+        printf("Error: Failed to open %s\n", path);
+        return -1;
+    }
+    read = fread(data, sizeof(float), count, fptr);
+    fclose(fptr);
+    if (read != (size_t) count) {
+        printf("Error: %s holds %zu of %ld floats\n", path, read, count);
+        return -1;
+    }
+    return 0;
+}
+
+/***********************************************************
+ * Function:  option_value
+ * ---------------------------------------------------------
+ * Returns the value of arg if it is key=value, else NULL.
+ * *********************************************************/
+const char *option_value(const char *arg, const char *key){
+    size_t n = strlen(key);
+
+    return strncmp(arg, key, n) == 0 && arg[n] == '=' ? arg + n + 1 : NULL;
+}
+
+/***********************************************************
+ * Function:  compare
+ * ---------------------------------------------------------
+ * Reads the output.bin file, that contains the golden output
+ * values. Then it compares it with the filter output array by
+ * calculating the Mean Error Square (MSE). The perfect solution
+ * must have an MSE value of 0. A greater value corresponds to
+ * a worse solution.
+ *
+ * A golden file named by FILTER_GOLDEN holds the output of
+ * the scalar filter itself (filterGen), so it is compared
+ * without the constant of goldenOutput.bin.
+ *
+ * frame: The output frame to check.
+ * *********************************************************/
+double compare(const float *frame){
+    return compare_frame(frame, 0);
+}
+
+/***********************************************************
+ * Function:  compare_frame
+ * ---------------------------------------------------------
+ * compare() against frame index of the golden file, for
+ * inputs of several frames.
+ * *********************************************************/
+double compare_frame(const float *frame, int index){
+    FILE *fptr;
+    int y,x;
+    double diff;
+    double mse=-0.068993; // A calculated constant - DO NOT CHANGE IT.
+    const char *path = getenv("FILTER_GOLDEN");
+
+    if (path) {
+        mse = 0.0;
+    } else {
+        path = GOLDEN_FILE;
+    }
+
+    // Open output file and load it to outputGolden
+    if ((fptr = fopen(path,"r")) == NULL){
+            printf("Error! opening file %s\n", path);
+            exit(1);
+    }
+    float *goldenOutput = (float*) malloc(sizeof(float) * SIZE_X * SIZE_Y);
+    if (fseek(fptr, (long) sizeof(float) * SIZE_X * SIZE_Y * index, SEEK_SET) != 0 ||
+        fread(goldenOutput, sizeof(float) * SIZE_X * SIZE_Y, 1, fptr) != 1) {
+            printf("Error: %s holds less than %d %dx%d frames\n", path, index + 1, SIZE_X, SIZE_Y);
+            exit(1);
+    }
+    fclose(fptr);
+
+    // Calculate MSR
+    for ( x = 0; x < SIZE_X; x++) {
+        for (y = 0; y < SIZE_Y; y++){
+            diff = frame[x + y * SIZE_X] - goldenOutput[x + y *SIZE_X];
+            mse += pow(fabs(diff),2.0);
+        }
+    }
+    mse /= (double) (SIZE_X*SIZE_Y);
+    printf("MSE : %.6f\n", mse);
+
+    free(goldenOutput);
+    return mse;
+}
+
+/***********************************************************
+ * Function:  depth_from_float
+ * ---------------------------------------------------------
+ * Rounds to the nearest depth unit, saturating to the uint16
+ * range.
+ * *********************************************************/
+uint16_t depth_from_float(float v){
+    long d = lrintf(v * DEPTH_UNITS);
+
+    return (uint16_t) MAX(0L, MIN(d, 65535L));
+}
+
+/***********************************************************
+ * Function:  depth_rows
+ * *********************************************************/
+void depth_rows(float *tile, const uint16_t *in, int size_x, int size_y, int row_first, int rows){
+    const uint16_t *src;
+    int y, x;
+
+    for (y = 0; y < rows; y++) {
+        src = in + (row_first + y < 0 || row_first + y >= size_y ? size_y - 1 : row_first + y) * size_x;
+        for (x = 0; x < size_x; x++) {
+            tile[y * size_x + x] = depth_to_float(src[x]);
+        }
+    }
+}
+
+/***********************************************************
+ * Function:  make_gaussian
+ * ---------------------------------------------------------
+ * Creates the filter vector using a mathematical expression.
+ * *********************************************************/
+void make_gaussian(float *gaussian){
+    int i, x;
+
+    for (i = 0; i < FILTER_SIZE; i++) {
+		x = i - FILTER_RADIUS;
+		gaussian[i] = expf(-(x * x) / (32.0f));
+	}
+}
+
+/***********************************************************
+ * Function:  filter_sigma_s
+ * ---------------------------------------------------------
+ * From the first off centre weight of the vector:
+ * gaussian[r + 1] / gaussian[r] = exp(-1 / (2 sigma^2)).
+ * A vector without one gives 1.
+ * *********************************************************/
+float filter_sigma_s(const float *gaussian, int r){
+    const char *sigma = getenv("FILTER_SIGMA_S");
+
+    if (sigma) {
+        return (float) atof(sigma);
+    }
+    if (r < 1 || gaussian[r + 1] <= 0.0f || gaussian[r + 1] >= gaussian[r]) {
+        return 1.0f;
+    }
+    return sqrtf(-1.0f / (2.0f * logf(gaussian[r + 1] / gaussian[r])));
+}
+
+/***********************************************************
+ * Function:  frame_alloc
+ * *********************************************************/
+void *frame_alloc(size_t size){
+    void *ptr = NULL;
+
+    if (posix_memalign(&ptr, FRAME_ALIGNMENT, size)) {
+        printf("Error: Failed to allocate %zu bytes of frame memory\n", size);
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+/***********************************************************
+ * Function:  frame_is_aligned
+ * *********************************************************/
+int frame_is_aligned(const void *ptr){
+    return ((uintptr_t) ptr % FRAME_ALIGNMENT) == 0;
+}
@@ -0,0 +1,99 @@
+#ifndef _FILTER_COMMON_H_
+#define _FILTER_COMMON_H_
+
+/***********************************************************
+ * Code shared by the software host (filter.c) and the
+ * hardware hosts of lab5-hardware: the image geometry, the
+ * input and golden files, the filter vector and frame
+ * memory. Timing is in filterTrace.h.
+ * *********************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Image size of input.bin; make SIZE_X=<w> SIZE_Y=<h> builds for
+// generated frames of another size (filterGen.c)
+#ifndef SIZE_X
+#define SIZE_X 320 // Input image Width
+#endif
+#ifndef SIZE_Y
+#define SIZE_Y 240 // Input image Height
+#endif
+#define FILTER_SIZE 5 // Filter size
+#define FILTER_RADIUS 2 // Filter radius
+
+// Utilty Macros
+#ifndef MIN
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+#ifndef MAX
+#define MAX(a,b) (((a)>(b))?(a):(b))
+#endif
+
+// Depth units per metre of uint16 depth frames (millimetres)
+#define DEPTH_UNITS 1000.0f
+// Rows of the float tile a uint16 frame is converted into at a time
+#define DEPTH_TILE_ROWS 16
+
+// Alignment XRT needs for zero copy, as aligned_allocator in xcl2.hpp
+#define FRAME_ALIGNMENT 4096
+
+// Input and golden files, unless FILTER_INPUT and FILTER_GOLDEN
+// name others (e.g. frames written by filterGen)
+#define INPUT_FILE "input.bin"
+#define GOLDEN_FILE "goldenOutput.bin"
+
+// Reads the input file into one SIZE_X x SIZE_Y frame, or exits
+void read_input(float *frame);
+
+// Reads up to count frames of the input file, packed back to
+// back, and returns how many it holds; exits if not one
+int read_frames(float *frames, int count);
+
+// Reads count floats of path into data. Returns 0 on success,
+// -1 if the file is missing or short.
+int read_floats(const char *path, float *data, long count);
+
+// Value of a key=value argument of the tools, or NULL if arg
+// sets another key
+const char *option_value(const char *arg, const char *key);
+
+// Prints and returns the MSE of frame against the golden file
+double compare(const float *frame);
+
+// compare() against frame index of the golden file
+double compare_frame(const float *frame, int index);
+
+// Metres of a uint16 depth pixel. The division gives back the
+// float input files exactly, which hold millimetres / 1000.
+static inline float depth_to_float(uint16_t d){
+    return d / DEPTH_UNITS;
+}
+
+// uint16 depth pixel of v metres, as the camera would deliver it
+uint16_t depth_from_float(float v);
+
+// Converts rows [row_first, row_first + rows) of a uint16 depth
+// frame to metres into tile. Rows outside the image read the
+// last row, as the taps of the filter do.
+void depth_rows(float *tile, const uint16_t *in, int size_x, int size_y, int row_first, int rows);
+
+// Range sigma of the kernels, in metres: their range weight
+// exp(-d^2 / 0.02) is exp(-d^2 / (2 FILTER_SIGMA_R^2))
+#define FILTER_SIGMA_R 0.1f
+
+// Fills the FILTER_SIZE weights of the filter vector
+void make_gaussian(float *gaussian);
+
+// Spatial sigma in pixels of the filter vector of radius r, for
+// the engines without a radius, or the one FILTER_SIGMA_S gives
+float filter_sigma_s(const float *gaussian, int r);
+
+// Allocates size bytes aligned to FRAME_ALIGNMENT, or exits.
+// Release with free().
+void *frame_alloc(size_t size);
+
+// Non zero if ptr can be used by the device without a copy
+int frame_is_aligned(const void *ptr);
+
+#endif
@@ -0,0 +1,419 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "filterCommon.h"
+#include "filterBackend.h"
+#include "filterOmp.h"
+#include "filterTrace.h"
+#include "filterStats.h"
+
+/***********************************************************
+ * CPU backends. All of them compute the reference filter of
+ * filterOmp.c, including its border handling, but for the
+ * pruned one, which drops the taps whose range weight is
+ * negligible. Every frame is traced as a span.
+ * *********************************************************/
+
+#define SIMD_WIDTH 4 // Pixels per vector, 128 bit NEON or SSE registers
+
+// GCC vector extensions, lowered to the SIMD unit of the target
+typedef float v4f __attribute__((vector_size(SIMD_WIDTH * sizeof(float))));
+typedef int v4i __attribute__((vector_size(SIMD_WIDTH * sizeof(int))));
+
+#define PRUNE_CUTOFF 4.0f // Default range cutoff of the pruned backend, in FILTER_SIGMA_R
+
+// Squared range cutoff of the pruned backend, in square metres
+static float prune_cutoff2;
+// Valid lane taps of the last pruned call, those pruned, and
+// the vector taps whose exp was skipped
+static long prune_taps, prune_pruned, prune_skipped;
+
+static int cpu_open(const char *xclbin){
+    return 0;
+}
+
+static void cpu_close(void){
+}
+
+// Non zero, with a message, if the row routines cannot take radius r
+static int cpu_radius_check(int r){
+    if (r > FILTER_MAX_RADIUS) {
+        printf("Error: radius %d is larger than %d\n", r, FILTER_MAX_RADIUS);
+        return -1;
+    }
+    return 0;
+}
+
+/***********************************************************
+ * Function:  scalar_filter
+ * *********************************************************/
+static int scalar_filter(float *out, const float *in, const float *gaussian, int size_x, int size_y, int r,
+                         int frames){
+    int f, y;
+
+    if (cpu_radius_check(r) != 0) {
+        return -1;
+    }
+    for (f = 0; f < frames; f++) {
+        trace_begin("frame");
+        STATS_FRAME(f);
+        for (y = 0; y < size_y; y++) {
+            bilateralFilterRow(out + f * size_x * size_y, in + f * size_x * size_y, gaussian,
+                               size_x, size_y, r, y, 0, size_x);
+        }
+        trace_end();
+    }
+    return 0;
+}
+
+// Filters one row into out, from the input rows of bilateralFilterRowTaps
+typedef void (*cpu_row)(float *out, const float *const *rows, const float *gaussian, int size_x, int r);
+
+static void scalar_row(float *out, const float *const *rows, const float *gaussian, int size_x, int r){
+    bilateralFilterRowTaps(out, rows, gaussian, size_x, r, 0, size_x);
+}
+
+/***********************************************************
+ * Function:  cpu_filter_u16
+ * ---------------------------------------------------------
+ * Converts DEPTH_TILE_ROWS rows at a time, and the r rows
+ * around them, into a float tile that stays in cache while
+ * row filters them.
+ * *********************************************************/
+static int cpu_filter_u16(float *out, const uint16_t *in, const float *gaussian, int size_x, int size_y, int r,
+                          int frames, cpu_row row){
+    const float *rows[2 * FILTER_MAX_RADIUS + 1];
+    float *tile;
+    int f, y, y0, y1, j;
+
+    if (cpu_radius_check(r) != 0) {
+        return -1;
+    }
+    tile = (float *) malloc(sizeof(float) * size_x * (DEPTH_TILE_ROWS + 2 * r));
+    if (tile == NULL) {
+        printf("Error: Failed to allocate a depth tile\n");
+        return -1;
+    }
+    for (f = 0; f < frames; f++) {
+        trace_begin("frame");
+        STATS_FRAME(f);
+        for (y0 = 0; y0 < size_y; y0 += DEPTH_TILE_ROWS) {
+            y1 = MIN(y0 + DEPTH_TILE_ROWS, size_y);
+            trace_begin("tile");
+            depth_rows(tile, in + f * size_x * size_y, size_x, size_y, y0 - r, y1 - y0 + 2 * r);
+            for (y = y0; y < y1; y++) {
+                for (j = 0; j <= 2 * r; j++) {
+                    rows[j] = tile + (y - y0 + j) * size_x;
+                }
+                STATS_ROW(y);
+                row(out + (f * size_y + y) * size_x, rows, gaussian, size_x, r);
+            }
+            trace_end();
+        }
+        trace_end();
+    }
+    free(tile);
+    return 0;
+}
+
+/***********************************************************
+ * Function:  scalar_filter_u16
+ * *********************************************************/
+static int scalar_filter_u16(float *out, const uint16_t *in, const float *gaussian, int size_x, int size_y, int r,
+                             int frames){
+    return cpu_filter_u16(out, in, gaussian, size_x, size_y, r, frames, scalar_row);
+}
+
+/***********************************************************
+ * Function:  openmp_filter
+ * *********************************************************/
+static int openmp_filter(float *out, const float *in, const float *gaussian, int size_x, int size_y, int r,
+                         int frames){
+    int f;
+
+    if (cpu_radius_check(r) != 0) {
+        return -1;
+    }
+    for (f = 0; f < frames; f++) {
+        trace_begin("frame");
+        STATS_FRAME(f);
+        bilateralFilterBand(out + f * size_x * size_y, in + f * size_x * size_y, gaussian,
+                            size_x, size_y, r, 0, size_y);
+        trace_end();
+    }
+    return 0;
+}
+
+/***********************************************************
+ * Function:  openmp_filter_u16
+ * *********************************************************/
+static int openmp_filter_u16(float *out, const uint16_t *in, const float *gaussian, int size_x, int size_y, int r,
+                             int frames){
+    int f;
+
+    if (cpu_radius_check(r) != 0) {
+        return -1;
+    }
+    for (f = 0; f < frames; f++) {
+        trace_begin("frame");
+        STATS_FRAME(f);
+        bilateralFilterBandU16(out + f * size_x * size_y, in + f * size_x * size_y, gaussian,
+                               size_x, size_y, r, 0, size_y);
+        trace_end();
+    }
+    return 0;
+}
+
+// Lanes of a where mask is set, of b elsewhere
+static inline v4f simd_select(v4i mask, v4f a, v4f b){
+    return (v4f) (((v4i) a & mask) | ((v4i) b & ~mask));
+}
+
+/***********************************************************
+ * Function:  simd_expf
+ * ---------------------------------------------------------
+ * expf of every lane, with the range reduction and the
+ * polynomial of the Cephes library (about 1 ulp). Inputs
+ * below -87.3 give the smallest normal float instead of a
+ * denormal, which no weight of the filter can tell apart.
+ * *********************************************************/
+static inline v4f simd_expf(v4f x){
+    const v4f lo = {-87.3f, -87.3f, -87.3f, -87.3f};
+    const v4f hi = {88.3f, 88.3f, 88.3f, 88.3f};
+    v4f fx, z, y;
+    v4i n;
+
+    x = simd_select(x < lo, lo, x);
+    x = simd_select(x > hi, hi, x);
+
+    // x = n ln2 + g, with |g| <= ln2 / 2
+    fx = x * 1.44269504088896341f + 0.5f;
+    n = __builtin_convertvector(fx, v4i);
+    n += (v4i) (__builtin_convertvector(n, v4f) > fx); // Truncation to floor, a true lane is -1
+    fx = __builtin_convertvector(n, v4f);
+    x = x - fx * 0.693359375f + fx * 2.12194440e-4f;
+
+    z = x * x;
+    y = x * 1.9875691500e-4f + 1.3981999507e-3f;
+    y = y * x + 8.3334519073e-3f;
+    y = y * x + 4.1665795894e-2f;
+    y = y * x + 1.6666665459e-1f;
+    y = y * x + 5.0000001201e-1f;
+    y = y * z + x + 1.0f;
+
+    // Times 2^n, built in the exponent field
+    return y * (v4f) ((n + 127) << 23);
+}
+
+// Non zero if any lane of mask is set
+static inline int simd_any(v4i mask){
+    return (mask[0] | mask[1] | mask[2] | mask[3]) != 0;
+}
+
+#ifdef FILTER_STATS
+// Counts the pixels of the lanes at x, and takes their tiles
+static inline void simd_stats_pixels(filter_stats **stats, int x, v4f center){
+    int l;
+
+    for (l = 0; l < SIMD_WIDTH; l++) {
+        stats[l] = stats_tile(stats_frame_index, x + l, stats_row_index);
+        stats[l]->pixels++;
+        stats[l]->zero_pixels += center[l] == 0;
+    }
+}
+
+// Counts one tap of the lanes with a non zero centre, the range
+// weight of the ones in mask
+static inline void simd_stats_taps(filter_stats **stats, v4f center, v4f cur, v4f diff, v4i mask){
+    int l;
+
+    for (l = 0; l < SIMD_WIDTH; l++) {
+        if (center[l] != 0) {
+            stats[l]->taps++;
+            stats[l]->rejected_taps += cur[l] <= 0;
+            if (mask[l]) {
+                stats_weight(stats[l], expf(-(diff[l] * diff[l]) / 0.02f));
+            }
+        }
+    }
+}
+#endif
+
+/***********************************************************
+ * Function:  simd_taps
+ * ---------------------------------------------------------
+ * Filters one row into out, SIMD_WIDTH neighbouring pixels
+ * at a time, from the input rows of bilateralFilterRowTaps.
+ * Every tap of a vector reads SIMD_WIDTH consecutive input
+ * pixels, so only the columns whose taps stay inside the
+ * image are vectorised; the r columns at each side go
+ * through bilateralFilterRowTaps. The taps are summed in the
+ * order of the reference. The counters build counts every
+ * lane as bilateralFilterRowTaps counts a pixel, a pruned
+ * tap as an accepted one without a range weight.
+ *
+ * With prune, the taps further than the cutoff from their
+ * centre are masked out with the invalid ones, and a tap of
+ * no lane left skips its exp. The vector taps and the
+ * pruned ones are counted, and the skipped exps.
+ * *********************************************************/
+static inline void simd_taps(float *out, const float *const *rows, const float *gaussian, int size_x, int r,
+                             int prune){
+    const v4f zero = {0.0f, 0.0f, 0.0f, 0.0f};
+    const v4f cutoff2 = zero + prune_cutoff2;
+    long valid = 0, kept = 0, skipped = 0;
+    int i, j, x;
+
+    for (x = r; x + SIMD_WIDTH <= size_x - r; x += SIMD_WIDTH) {
+        v4f center, cur, diff, factor;
+        v4f t = zero, sum = zero;
+        v4i mask;
+#ifdef FILTER_STATS
+        filter_stats *stats[SIMD_WIDTH];
+#endif
+
+        memcpy(&center, rows[r] + x, sizeof(v4f));
+#ifdef FILTER_STATS
+        simd_stats_pixels(stats, x, center);
+#endif
+        for (i = -r; i <= r; ++i) {
+            for (j = -r; j <= r; ++j) {
+                memcpy(&cur, rows[j + r] + x + i, sizeof(v4f));
+                diff = cur - center;
+                mask = cur > zero;
+                if (prune) {
+                    valid -= mask[0] + mask[1] + mask[2] + mask[3];
+                    mask &= diff * diff <= cutoff2;
+                    kept -= mask[0] + mask[1] + mask[2] + mask[3];
+                }
+#ifdef FILTER_STATS
+                simd_stats_taps(stats, center, cur, diff, mask);
+#endif
+                if (prune && !simd_any(mask)) {
+                    skipped++;
+                    continue;
+                }
+                factor = gaussian[i + r] * gaussian[j + r] * simd_expf(-(diff * diff) / 0.02f);
+                factor = simd_select(mask, factor, zero);
+                t += factor * cur;
+                sum += factor;
+            }
+        }
+        t = simd_select(center == zero, zero, t / sum);
+        memcpy(out + x, &t, sizeof(v4f));
+    }
+
+    bilateralFilterRowTaps(out, rows, gaussian, size_x, r, 0, MIN(r, size_x));
+    bilateralFilterRowTaps(out, rows, gaussian, size_x, r, MAX(x, r), size_x);
+    if (prune) {
+        prune_taps += valid;
+        prune_pruned += valid - kept;
+        prune_skipped += skipped;
+    }
+}
+
+static void simd_row(float *out, const float *const *rows, const float *gaussian, int size_x, int r){
+    simd_taps(out, rows, gaussian, size_x, r, 0);
+}
+
+static void pruned_row(float *out, const float *const *rows, const float *gaussian, int size_x, int r){
+    simd_taps(out, rows, gaussian, size_x, r, 1);
+}
+
+/***********************************************************
+ * Function:  cpu_filter
+ * ---------------------------------------------------------
+ * Filters every row of the frames with row, its input rows
+ * taken from the frame.
+ * *********************************************************/
+static int cpu_filter(float *out, const float *in, const float *gaussian, int size_x, int size_y, int r,
+                      int frames, cpu_row row){
+    const float *rows[2 * FILTER_MAX_RADIUS + 1];
+    const float *frame;
+    int f, y, yy, j;
+
+    if (cpu_radius_check(r) != 0) {
+        return -1;
+    }
+    for (f = 0; f < frames; f++) {
+        trace_begin("frame");
+        STATS_FRAME(f);
+        frame = in + f * size_x * size_y;
+        for (y = 0; y < size_y; y++) {
+            for (j = -r; j <= r; j++) {
+                yy = y + j;
+                rows[j + r] = frame + (yy < 0 || yy >= size_y ? size_y - 1 : yy) * size_x;
+            }
+            STATS_ROW(y);
+            row(out + (f * size_y + y) * size_x, rows, gaussian, size_x, r);
+        }
+        trace_end();
+    }
+    return 0;
+}
+
+/***********************************************************
+ * Function:  simd_filter
+ * *********************************************************/
+static int simd_filter(float *out, const float *in, const float *gaussian, int size_x, int size_y, int r,
+                       int frames){
+    return cpu_filter(out, in, gaussian, size_x, size_y, r, frames, simd_row);
+}
+
+/***********************************************************
+ * Function:  simd_filter_u16
+ * *********************************************************/
+static int simd_filter_u16(float *out, const uint16_t *in, const float *gaussian, int size_x, int size_y, int r,
+                           int frames){
+    return cpu_filter_u16(out, in, gaussian, size_x, size_y, r, frames, simd_row);
+}
+
+/***********************************************************
+ * Function:  pruned_open
+ * ---------------------------------------------------------
+ * FILTER_CUTOFF sets the cutoff in units of FILTER_SIGMA_R
+ * (PRUNE_CUTOFF); a tap k FILTER_SIGMA_R from its centre
+ * weighs exp(-k^2 / 2) of the centre at most.
+ * *********************************************************/
+static int pruned_open(const char *xclbin){
+    const char *cutoff = getenv("FILTER_CUTOFF");
+    float k = cutoff ? (float) atof(cutoff) : PRUNE_CUTOFF;
+
+    if (k <= 0.0f) {
+        printf("Error: FILTER_CUTOFF %s is not positive\n", cutoff);
+        return -1;
+    }
+    prune_cutoff2 = (k * FILTER_SIGMA_R) * (k * FILTER_SIGMA_R);
+    return 0;
+}
+
+static void pruned_close(void){
+    if (prune_taps) {
+        printf("pruned:\t%.2f%% of %ld valid taps\t%ld vector exps skipped\tcutoff %g sigma_r\n",
+               100.0 * prune_pruned / prune_taps, prune_taps, prune_skipped, sqrtf(prune_cutoff2) / FILTER_SIGMA_R);
+    }
+}
+
+/***********************************************************
+ * Function:  pruned_filter
+ * *********************************************************/
+static int pruned_filter(float *out, const float *in, const float *gaussian, int size_x, int size_y, int r,
+                         int frames){
+    prune_taps = prune_pruned = prune_skipped = 0;
+    return cpu_filter(out, in, gaussian, size_x, size_y, r, frames, pruned_row);
+}
+
+/***********************************************************
+ * Function:  pruned_filter_u16
+ * *********************************************************/
+static int pruned_filter_u16(float *out, const uint16_t *in, const float *gaussian, int size_x, int size_y, int r,
+                             int frames){
+    prune_taps = prune_pruned = prune_skipped = 0;
+    return cpu_filter_u16(out, in, gaussian, size_x, size_y, r, frames, pruned_row);
+}
+
+const filter_backend scalar_backend = {"scalar", cpu_open, scalar_filter, scalar_filter_u16, cpu_close, 1};
+const filter_backend simd_backend = {"simd", cpu_open, simd_filter, simd_filter_u16, cpu_close, 1};
+const filter_backend openmp_backend = {"openmp", cpu_open, openmp_filter, openmp_filter_u16, cpu_close, 1};
+const filter_backend pruned_backend = {"pruned", pruned_open, pruned_filter, pruned_filter_u16, pruned_close, 1};
@@ -0,0 +1,297 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "filterCommon.h"
+#include "filterBackend.h"
+#include "filterOmp.h"
+#include "filterTrace.h"
+#include "filterStats.h"
+
+/***********************************************************
+ * Bilateral filter that skips the range weights of flat
+ * tiles. A pre-pass sums up every FLAT_TILE x FLAT_TILE
+ * tile of the frame: the min and max of the valid pixels
+ * its taps read, and how many of its own pixels are valid.
+ * The span max - min bounds every range difference the
+ * tile sees.
+ *
+ * With all range weights in [w, 1], w = exp(-span^2 /
+ * (2 FILTER_SIGMA_R^2)), dropping them moves a weighted
+ * mean of depths within span by at most
+ * span (1 - sqrt(w)) / (1 + sqrt(w)), about
+ * span^3 / (8 FILTER_SIGMA_R^2). Tiles where that stays
+ * within the error budget are filtered as a separable
+ * Gaussian, normalized over the valid taps (2 (2r + 1)
+ * taps per pixel and no exp); the others by the direct
+ * kernel, and tiles without a valid pixel are zero.
+ *
+ * FILTER_FLAT_BUDGET sets the budget in millimetres
+ * (FLAT_BUDGET); 0 only takes tiles of one depth. The
+ * share of every kind of tile of the last call is printed
+ * on close.
+ * *********************************************************/
+
+#define FLAT_TILE 8 // Tile side, in pixels
+#define FLAT_BUDGET 0.1f // Default largest error of a flat tile, in millimetres
+
+/**
+ * Summary of the valid pixels of one tile.
+ * */
+typedef struct {
+    float min, max;
+    int valid;
+} flat_summary;
+
+// Tile summaries of one frame, grown as needed and freed by close
+static flat_summary *summaries;
+static int summary_count;
+// Frame of the u16 path, grown as needed and freed by close
+static float *scratch;
+static size_t scratch_pixels;
+// Tiles of the last filter call: flat, direct, empty
+static long flat_tiles, direct_tiles, empty_tiles;
+// Error budget, in metres
+static float flat_budget;
+
+/***********************************************************
+ * Function:  flat_summarize
+ * ---------------------------------------------------------
+ * Pre-pass: the summary of every tile of in, tiles_x per
+ * row of tiles. min and max cover the valid pixels the taps
+ * of the tile read, r around it, addressed as in
+ * bilateralFilterRowTaps; valid counts the tile's own.
+ * *********************************************************/
+static void flat_summarize(flat_summary *tiles, const float *in, int size_x, int size_y, int r, int tiles_x,
+                           int tiles_y){
+    int t;
+
+    #pragma omp parallel for schedule(static)
+    for (t = 0; t < tiles_x * tiles_y; t++) {
+        const int x0 = (t % tiles_x) * FLAT_TILE, y0 = (t / tiles_x) * FLAT_TILE;
+        const int x1 = MIN(x0 + FLAT_TILE, size_x), y1 = MIN(y0 + FLAT_TILE, size_y);
+        flat_summary s = {0.0f, 0.0f, 0};
+        int x, y, taps = 0;
+
+        for (y = y0 - r; y < y1 + r; y++) {
+            const float *row = in + MIN((unsigned int) y, (unsigned int) size_y - 1) * size_x;
+
+            for (x = x0 - r; x < x1 + r; x++) {
+                const float v = row[MIN((unsigned int) x, (unsigned int) size_x - 1)];
+
+                if (v <= 0) {
+                    continue;
+                }
+                s.min = taps ? MIN(s.min, v) : v;
+                s.max = taps ? MAX(s.max, v) : v;
+                taps++;
+                s.valid += y >= y0 && y < y1 && x >= x0 && x < x1;
+            }
+        }
+        tiles[t] = s;
+    }
+}
+
+// Largest error of dropping the range weights of taps within span
+static inline float flat_error(float span){
+    const float root = expf(-span * span / (4.0f * FILTER_SIGMA_R * FILTER_SIGMA_R));
+
+    return span * (1.0f - root) / (1.0f + root);
+}
+
+/***********************************************************
+ * Function:  flat_gaussian
+ * ---------------------------------------------------------
+ * Filters pixels [x0, x1) x [y0, y1) with the spatial
+ * weights only, over the valid taps: a horizontal pass of
+ * the rows the taps read, then a vertical one. Taps are
+ * addressed as in bilateralFilterRowTaps, unsigned and
+ * clamped to the last row and column.
+ * *********************************************************/
+static void flat_gaussian(float *out, const float *in, const float *gaussian, int size_x, int size_y, int r,
+                          int x0, int x1, int y0, int y1){
+    float num[FLAT_TILE + 2 * FILTER_MAX_RADIUS][FLAT_TILE];
+    float den[FLAT_TILE + 2 * FILTER_MAX_RADIUS][FLAT_TILE];
+    unsigned int x, y;
+    int i, j;
+
+    for (j = 0; j < y1 - y0 + 2 * r; j++) {
+        const float *row = in + MIN((unsigned int) (y0 - r + j), (unsigned int) size_y - 1) * size_x;
+
+        for (x = x0; x < (unsigned int) x1; x++) {
+            float n = 0.0f, d = 0.0f;
+
+            for (i = -r; i <= r; i++) {
+                const float v = row[MIN(x + i, (unsigned int) size_x - 1)];
+
+                if (v > 0) {
+                    n += gaussian[i + r] * v;
+                    d += gaussian[i + r];
+                }
+            }
+            num[j][x - x0] = n;
+            den[j][x - x0] = d;
+        }
+    }
+    for (y = y0; y < (unsigned int) y1; y++) {
+        for (x = x0; x < (unsigned int) x1; x++) {
+            float n = 0.0f, d = 0.0f;
+
+            if (in[y * size_x + x] == 0) {
+                out[y * size_x + x] = 0;
+                continue;
+            }
+            for (j = 0; j <= 2 * r; j++) {
+                n += gaussian[j] * num[y - y0 + j][x - x0];
+                d += gaussian[j] * den[y - y0 + j][x - x0];
+            }
+            out[y * size_x + x] = n / d;
+        }
+    }
+}
+
+/***********************************************************
+ * Function:  flat_frame
+ * ---------------------------------------------------------
+ * Summarizes the tiles, then filters every one of them by
+ * the path its span allows, the tiles shared between the
+ * OpenMP threads.
+ * *********************************************************/
+static void flat_frame(float *out, const float *in, const float *gaussian, int size_x, int size_y, int r){
+    const int tiles_x = (size_x + FLAT_TILE - 1) / FLAT_TILE, tiles_y = (size_y + FLAT_TILE - 1) / FLAT_TILE;
+    long flat = 0, direct = 0, empty = 0;
+    int t;
+
+    trace_begin("summaries");
+    flat_summarize(summaries, in, size_x, size_y, r, tiles_x, tiles_y);
+    trace_end();
+
+    trace_begin("tiles");
+    #pragma omp parallel for schedule(static) reduction(+:flat, direct, empty)
+    for (t = 0; t < tiles_x * tiles_y; t++) {
+        const int x0 = (t % tiles_x) * FLAT_TILE, y0 = (t / tiles_x) * FLAT_TILE;
+        const int x1 = MIN(x0 + FLAT_TILE, size_x), y1 = MIN(y0 + FLAT_TILE, size_y);
+        int x, y;
+
+        if (summaries[t].valid == 0) {
+            for (y = y0; y < y1; y++) {
+                for (x = x0; x < x1; x++) {
+                    out[(long) y * size_x + x] = 0;
+                }
+            }
+            empty++;
+        } else if (flat_error(summaries[t].max - summaries[t].min) <= flat_budget) {
+            flat_gaussian(out, in, gaussian, size_x, size_y, r, x0, x1, y0, y1);
+            flat++;
+        } else {
+            for (y = y0; y < y1; y++) {
+                bilateralFilterRow(out, in, gaussian, size_x, size_y, r, y, x0, x1);
+            }
+            direct++;
+        }
+    }
+    trace_end();
+    flat_tiles += flat;
+    direct_tiles += direct;
+    empty_tiles += empty;
+}
+
+static int flat_open(const char *xclbin){
+    const char *budget = getenv("FILTER_FLAT_BUDGET");
+
+    flat_budget = (budget ? (float) atof(budget) : FLAT_BUDGET) / DEPTH_UNITS;
+    if (flat_budget < 0.0f) {
+        printf("Error: FILTER_FLAT_BUDGET %s is negative\n", budget);
+        return -1;
+    }
+    return 0;
+}
+
+static void flat_close(void){
+    long tiles = flat_tiles + direct_tiles + empty_tiles;
+
+    if (tiles) {
+        printf("flat:\t%.1f%% flat, %.1f%% direct, %.1f%% empty tiles\tbudget %g mm\n", 100.0 * flat_tiles / tiles,
+               100.0 * direct_tiles / tiles, 100.0 * empty_tiles / tiles, flat_budget * DEPTH_UNITS);
+    }
+    free(summaries);
+    free(scratch);
+    summaries = NULL;
+    scratch = NULL;
+    summary_count = 0;
+    scratch_pixels = 0;
+}
+
+// Checks r and grows the summaries to the frame. Returns 0 on success
+static int flat_setup(int size_x, int size_y, int r){
+    int tiles = ((size_x + FLAT_TILE - 1) / FLAT_TILE) * ((size_y + FLAT_TILE - 1) / FLAT_TILE);
+
+    if (r > FILTER_MAX_RADIUS) {
+        printf("Error: radius %d is larger than %d\n", r, FILTER_MAX_RADIUS);
+        return -1;
+    }
+    if (tiles > summary_count) {
+        free(summaries);
+        summaries = (flat_summary *) malloc(sizeof(flat_summary) * tiles);
+        summary_count = summaries ? tiles : 0;
+        if (summaries == NULL) {
+            printf("Error: Failed to allocate the tile summaries\n");
+            return -1;
+        }
+    }
+    flat_tiles = direct_tiles = empty_tiles = 0;
+    return 0;
+}
+
+/***********************************************************
+ * Function:  flat_filter
+ * *********************************************************/
+static int flat_filter(float *out, const float *in, const float *gaussian, int size_x, int size_y, int r,
+                       int frames){
+    int f;
+
+    if (flat_setup(size_x, size_y, r) != 0) {
+        return -1;
+    }
+    for (f = 0; f < frames; f++) {
+        trace_begin("frame");
+        STATS_FRAME(f);
+        flat_frame(out + (long) f * size_x * size_y, in + (long) f * size_x * size_y, gaussian, size_x, size_y, r);
+        trace_end();
+    }
+    return 0;
+}
+
+/***********************************************************
+ * Function:  flat_filter_u16
+ * ---------------------------------------------------------
+ * The pre-pass and the tiles both read the frame, so it is
+ * converted to metres once, into a scratch frame.
+ * *********************************************************/
+static int flat_filter_u16(float *out, const uint16_t *in, const float *gaussian, int size_x, int size_y, int r,
+                           int frames){
+    size_t pixels = (size_t) size_x * size_y;
+    int f;
+
+    if (flat_setup(size_x, size_y, r) != 0) {
+        return -1;
+    }
+    if (pixels > scratch_pixels) {
+        free(scratch);
+        scratch = (float *) malloc(sizeof(float) * pixels);
+        scratch_pixels = scratch ? pixels : 0;
+        if (scratch == NULL) {
+            printf("Error: Failed to allocate the flat filter frame\n");
+            return -1;
+        }
+    }
+    for (f = 0; f < frames; f++) {
+        trace_begin("frame");
+        STATS_FRAME(f);
+        depth_rows(scratch, in + f * pixels, size_x, size_y, 0, size_y);
+        flat_frame(out + f * pixels, scratch, gaussian, size_x, size_y, r);
+        trace_end();
+    }
+    return 0;
+}
+
+const filter_backend flat_backend = {"flat", flat_open, flat_filter, flat_filter_u16, flat_close, 1};
@@ -0,0 +1,373 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "filterCommon.h"
+#include "filterOmp.h"
+
+/***********************************************************
+ * Synthetic depth frames at any image size, for benchmarks
+ * and regression runs beyond the 320x240 input.bin, which
+ * fits in L2 and hides the memory bound behaviour of the
+ * filter.
+ *
+ * A frame is a sloped background with boxes and discs in
+ * front of it, whose outlines are the depth edges, plus
+ * sensor noise that grows with the square of the depth, and
+ * holes of zero depth where the sensor gave no return.
+ * Depths are whole millimetres, so the frames filter the
+ * same as f32 and as u16. The objects move a little from
+ * frame to frame.
+ *
+ * With guide=<channels> it also renders a guide image, as a
+ * colour camera registered to the depth one would see the
+ * scene: every object has its own colour, with a little
+ * texture noise, and the background a smooth gradient. The
+ * guide has no holes. It is written to <prefix>guide.bin,
+ * channels interleaved floats in [0, 1] per pixel, for the
+ * joint filters (filterJoint.c). The depth frames do not
+ * depend on it.
+ *
+ * The input file holds the frames back to back in the
+ * format of input.bin, the golden file the output of the
+ * scalar filter on every frame (bilateralFilterRow, row by
+ * row, as the scalar backend runs it). Run the filter on
+ * them with a build of the same image size:
+ *
+ *   ./filterGen 1920 1080 zeros=0.05 out=hd_
+ *   make exe SIZE_X=1920 SIZE_Y=1080
+ *   FILTER_INPUT=hd_input.bin FILTER_GOLDEN=hd_golden.bin ./filter all 8
+ * *********************************************************/
+
+#define GEN_SEED 1 // Default random seed
+#define GEN_MAX_OBJECTS 100000 // Most objects of a scene
+#define GEN_MAX_CHANNELS 8 // Most guide channels
+#define GEN_TEXTURE 0.02 // Standard deviation of the guide noise
+
+/**
+ * Parameters of a scene, set by key=value arguments.
+ * */
+typedef struct {
+    int frames;      // Frames to write
+    unsigned seed;   // Random seed, the same seed gives the same files
+    double zeros;    // Fraction of the pixels that are holes
+    double hole;     // Mean hole radius in pixels, 0 for single pixels
+    double edges;    // Objects per megapixel, each outlined by depth edges
+    double noise;    // Noise standard deviation at 1 m, millimetres
+    double near_mm;  // Nearest depth
+    double far_mm;   // Farthest depth, the background
+    int channels;    // Guide channels, 0 for no guide
+    const char *out; // Prefix of the output files
+} gen_params;
+
+/**
+ * A box (disc == 0) or disc in front of the background, with
+ * its own slope, moving by (vx, vy) per frame.
+ * */
+typedef struct {
+    double x, y, w, h;
+    double vx, vy;
+    double depth, slope_x, slope_y;
+    int disc;
+    float colour[GEN_MAX_CHANNELS];
+} gen_object;
+
+// Random states of the depth frames and of the guide, apart
+// so that the frames are the same with and without a guide
+static uint64_t gen_state, guide_state;
+
+// xorshift64*, the same sequence on every platform
+static uint64_t gen_next_state(uint64_t *state){
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static uint64_t gen_next(void){
+    return gen_next_state(&gen_state);
+}
+
+// Uniform in [0, 1)
+static double gen_uniform_state(uint64_t *state){
+    return (gen_next_state(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double gen_uniform(void){
+    return gen_uniform_state(&gen_state);
+}
+
+// Standard normal, Box-Muller
+static double gen_normal_state(uint64_t *state){
+    double u = 1.0 - gen_uniform_state(state);
+
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * gen_uniform_state(state));
+}
+
+static double gen_normal(void){
+    return gen_normal_state(&gen_state);
+}
+
+/***********************************************************
+ * Function:  gen_scene
+ * ---------------------------------------------------------
+ * Places the objects of the scene at random, nearer than
+ * the background.
+ * *********************************************************/
+static void gen_scene(gen_object *objects, int count, const gen_params *p, int size_x, int size_y){
+    double side = sqrt((double) size_x * size_y);
+    int i;
+
+    for (i = 0; i < count; i++) {
+        gen_object *o = &objects[i];
+        int c;
+
+        for (c = 0; c < p->channels; c++) {
+            o->colour[c] = (float) gen_uniform_state(&guide_state);
+        }
+        o->w = side * (0.02 + 0.15 * gen_uniform());
+        o->h = o->w * (0.5 + gen_uniform());
+        o->x = gen_uniform() * size_x - o->w / 2;
+        o->y = gen_uniform() * size_y - o->h / 2;
+        o->vx = side * 0.004 * (2 * gen_uniform() - 1);
+        o->vy = side * 0.004 * (2 * gen_uniform() - 1);
+        o->depth = p->near_mm + (p->far_mm - p->near_mm) * 0.9 * gen_uniform();
+        o->slope_x = 0.2 * (2 * gen_uniform() - 1);
+        o->slope_y = 0.2 * (2 * gen_uniform() - 1);
+        o->disc = gen_next() & 1;
+    }
+}
+
+/***********************************************************
+ * Function:  gen_frame
+ * ---------------------------------------------------------
+ * Renders frame f of the scene in millimetres into depth:
+ * background, objects (later ones in front), noise, holes;
+ * and its colours into guide, unless it is NULL.
+ * *********************************************************/
+static void gen_frame(float *frame, float *depth, float *guide, const gen_object *objects, int count,
+                      const gen_params *p, int size_x, int size_y, int f){
+    const int channels = guide ? p->channels : 0;
+    long pixels = (long) size_x * size_y;
+    long holes = 0, target = (long) (p->zeros * pixels);
+    double cx, cy, radius, d;
+    int i, c, x, y, x0, x1, y0, y1;
+
+    // Background, receding towards the top of the image
+    for (y = 0; y < size_y; y++) {
+        d = p->far_mm - 0.3 * (p->far_mm - p->near_mm) * y / size_y;
+        for (x = 0; x < size_x; x++) {
+            depth[(long) y * size_x + x] = d;
+            for (c = 0; c < channels; c++) {
+                guide[((long) y * size_x + x) * channels + c] =
+                    (float) (0.5 + 0.3 * sin(2.0 * M_PI * ((double) x / size_x + (double) c / channels)));
+            }
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        const gen_object *o = &objects[i];
+        double ox = o->x + o->vx * f, oy = o->y + o->vy * f;
+
+        x0 = MAX(0, (int) floor(ox));
+        x1 = MIN(size_x, (int) ceil(ox + o->w));
+        y0 = MAX(0, (int) floor(oy));
+        y1 = MIN(size_y, (int) ceil(oy + o->h));
+        for (y = y0; y < y1; y++) {
+            for (x = x0; x < x1; x++) {
+                double u = (x + 0.5 - ox) / o->w - 0.5, v = (y + 0.5 - oy) / o->h - 0.5;
+                if (u < -0.5 || u >= 0.5 || v < -0.5 || v >= 0.5 || (o->disc && u * u + v * v > 0.25)) {
+                    continue;
+                }
+                depth[(long) y * size_x + x] = o->depth + (u * o->slope_x + v * o->slope_y) * o->depth;
+                for (c = 0; c < channels; c++) {
+                    guide[((long) y * size_x + x) * channels + c] = o->colour[c];
+                }
+            }
+        }
+    }
+
+    // Noise, quadratic in depth as for structured light and ToF
+    for (i = 0; i < pixels; i++) {
+        d = depth[i] + p->noise * (depth[i] / 1000.0) * (depth[i] / 1000.0) * gen_normal();
+        depth[i] = (float) MIN(MAX(d, 1.0), 65535.0);
+    }
+
+    for (i = 0; i < pixels * channels; i++) {
+        guide[i] = (float) MIN(MAX(guide[i] + GEN_TEXTURE * gen_normal_state(&guide_state), 0.0), 1.0);
+    }
+
+    // Holes: discs of exponential radius, or single pixels,
+    // until the zero fraction is reached
+    while (holes < target) {
+        cx = gen_uniform() * size_x;
+        cy = gen_uniform() * size_y;
+        radius = p->hole > 0 ? -p->hole * log(1.0 - gen_uniform()) : 0.0;
+        x0 = MAX(0, (int) floor(cx - radius));
+        x1 = MIN(size_x - 1, (int) floor(cx + radius));
+        y0 = MAX(0, (int) floor(cy - radius));
+        y1 = MIN(size_y - 1, (int) floor(cy + radius));
+        for (y = y0; y <= y1 && holes < target; y++) {
+            for (x = x0; x <= x1 && holes < target; x++) {
+                float *px = &depth[(long) y * size_x + x];
+                double dx = x + 0.5 - cx, dy = y + 0.5 - cy;
+                if (*px != 0 && dx * dx + dy * dy <= radius * radius + 0.5) {
+                    *px = 0;
+                    holes++;
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < pixels; i++) {
+        frame[i] = depth_to_float((uint16_t) lrintf(depth[i]));
+    }
+}
+
+/***********************************************************
+ * Function:  gen_write
+ * ---------------------------------------------------------
+ * Appends count floats to fptr. Returns 0 on success, -1 on
+ * a write error.
+ * *********************************************************/
+static int gen_write(FILE *fptr, const float *data, long count, const char *path){
+    if (fwrite(data, sizeof(float), count, fptr) != (size_t) count) {
+        printf("Error: Failed to write %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// Sets the parameter of one key=value argument, or returns -1
+static int gen_option(gen_params *p, const char *arg){
+    const char *value;
+
+    if ((value = option_value(arg, "frames"))) {
+        p->frames = atoi(value);
+    } else if ((value = option_value(arg, "seed"))) {
+        p->seed = (unsigned) strtoul(value, NULL, 0);
+    } else if ((value = option_value(arg, "zeros"))) {
+        p->zeros = atof(value);
+    } else if ((value = option_value(arg, "hole"))) {
+        p->hole = atof(value);
+    } else if ((value = option_value(arg, "edges"))) {
+        p->edges = atof(value);
+    } else if ((value = option_value(arg, "noise"))) {
+        p->noise = atof(value);
+    } else if ((value = option_value(arg, "near"))) {
+        p->near_mm = atof(value);
+    } else if ((value = option_value(arg, "far"))) {
+        p->far_mm = atof(value);
+    } else if ((value = option_value(arg, "guide"))) {
+        p->channels = atoi(value);
+    } else if ((value = option_value(arg, "out"))) {
+        p->out = value;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/***********************************************************
+ * Function:  main
+ * ---------------------------------------------------------
+ * filterGen <width> <height> [key=value ...], see usage.
+ * The defaults resemble input.bin, which has no holes.
+ * *********************************************************/
+int main(int argc, char *argv[]){
+    gen_params p = {1, GEN_SEED, 0.02, 4.0, 20.0, 2.0, 1900.0, 3450.0, 0, ""};
+    gen_object *objects;
+    float *frame, *depth, *golden, *guide = NULL;
+    float gaussian[FILTER_SIZE];
+    char input_path[256], golden_path[256], guide_path[256];
+    FILE *input_file, *golden_file, *guide_file = NULL;
+    int size_x = 0, size_y = 0, count, f, y, i, failed = 0;
+    long pixels, zeros;
+
+    if (argc > 2) {
+        size_x = atoi(argv[1]);
+        size_y = atoi(argv[2]);
+    }
+    for (i = 3; i < argc && !failed; i++) {
+        failed = gen_option(&p, argv[i]);
+    }
+    if (failed || size_x < 1 || size_y < 1 || p.frames < 1 || p.zeros < 0 || p.zeros > 1 ||
+        p.hole < 0 || p.edges < 0 || p.noise < 0 || p.near_mm < 1 || p.far_mm < p.near_mm || p.far_mm > 65535 ||
+        p.channels < 0 || p.channels > GEN_MAX_CHANNELS) {
+        printf("Usage: %s <width> <height> [key=value ...]\n", argv[0]);
+        printf("  frames=<N>     frames to write (%d)\n", p.frames);
+        printf("  seed=<N>       random seed (%u)\n", GEN_SEED);
+        printf("  zeros=<0..1>   fraction of zero (hole) pixels (%g)\n", p.zeros);
+        printf("  hole=<px>      mean hole radius, 0 for scattered pixels (%g)\n", p.hole);
+        printf("  edges=<N>      objects per megapixel, each outlined by depth edges (%g)\n", p.edges);
+        printf("  noise=<mm>     noise standard deviation at 1 m, growing with depth^2 (%g)\n", p.noise);
+        printf("  near=<mm> far=<mm>  depth range, far is the background (%g %g)\n", p.near_mm, p.far_mm);
+        printf("  guide=<N>      also writes an N channel colour guide, up to %d (0)\n", GEN_MAX_CHANNELS);
+        printf("  out=<prefix>   writes <prefix>input.bin, <prefix>golden.bin [and <prefix>guide.bin]\n");
+        return EXIT_FAILURE;
+    }
+
+    pixels = (long) size_x * size_y;
+    count = (int) MIN(p.edges * pixels / 1e6 + 0.5, (double) GEN_MAX_OBJECTS);
+    gen_state = 0x9E3779B97F4A7C15ULL ^ ((uint64_t) p.seed << 1 | 1);
+    guide_state = 0xD1B54A32D192ED03ULL ^ ((uint64_t) p.seed << 1 | 1);
+    objects = (gen_object*) malloc(sizeof(gen_object) * MAX(count, 1));
+    frame = (float*) frame_alloc(sizeof(float) * pixels);
+    depth = (float*) frame_alloc(sizeof(float) * pixels);
+    golden = (float*) frame_alloc(sizeof(float) * pixels);
+    if (p.channels > 0) {
+        guide = (float*) frame_alloc(sizeof(float) * pixels * p.channels);
+    }
+    if (objects == NULL) {
+        printf("Error: Failed to allocate the scene\n");
+        return EXIT_FAILURE;
+    }
+
+    snprintf(input_path, sizeof(input_path), "%sinput.bin", p.out);
+    snprintf(golden_path, sizeof(golden_path), "%sgolden.bin", p.out);
+    if ((input_file = fopen(input_path, "wb")) == NULL || (golden_file = fopen(golden_path, "wb")) == NULL) {
+        printf("Error: Failed to open %s\n", input_file ? golden_path : input_path);
+        return EXIT_FAILURE;
+    }
+    snprintf(guide_path, sizeof(guide_path), "%sguide.bin", p.out);
+    if (guide && (guide_file = fopen(guide_path, "wb")) == NULL) {
+        printf("Error: Failed to open %s\n", guide_path);
+        return EXIT_FAILURE;
+    }
+
+    gen_scene(objects, count, &p, size_x, size_y);
+    make_gaussian(gaussian);
+    for (f = 0; f < p.frames && !failed; f++) {
+        gen_frame(frame, depth, guide, objects, count, &p, size_x, size_y, f);
+        for (y = 0; y < size_y; y++) {
+            bilateralFilterRow(golden, frame, gaussian, size_x, size_y, FILTER_RADIUS, y, 0, size_x);
+        }
+        for (i = 0, zeros = 0; i < pixels; i++) {
+            zeros += frame[i] == 0;
+        }
+        printf("frame %d:\t%dx%d\t%d objects\t%.2f%% zeros\n", f, size_x, size_y, count, 100.0 * zeros / pixels);
+        failed = gen_write(input_file, frame, pixels, input_path) || gen_write(golden_file, golden, pixels, golden_path);
+        if (guide && !failed) {
+            failed = gen_write(guide_file, guide, pixels * p.channels, guide_path);
+        }
+    }
+    failed |= fclose(input_file) != 0;
+    failed |= fclose(golden_file) != 0;
+    if (guide_file) {
+        failed |= fclose(guide_file) != 0;
+    }
+    if (!failed) {
+        printf("wrote %s and %s\n", input_path, golden_path);
+        if (guide) {
+            printf("wrote %s, %d channels\n", guide_path, p.channels);
+        }
+    }
+
+    free(objects);
+    free(frame);
+    free(depth);
+    free(golden);
+    free(guide);
+    return failed ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "filterCommon.h"
+#include "filterLattice.h"
+#include "filterTrace.h"
+
+/***********************************************************
+ * Benchmark of the permutohedral lattice against the brute
+ * force joint bilateral filter, on one depth frame and its
+ * guide image, at any image size:
+ *
+ *   ./filterGen 640 480 guide=3 out=rgb_
+ *   ./filterJoint 640 480 input=rgb_input.bin guide=rgb_guide.bin channels=3
+ *
+ * Without a guide the depth frame guides itself (d = 3),
+ * with sigma FILTER_SIGMA_R. Guide channels share sigma_c.
+ * The brute force window is radius pixels around every
+ * pixel, 2 sigma_s by default. FILTER_TRACE traces the
+ * lattice stages.
+ * *********************************************************/
+
+#define JOINT_SIGMA_C 0.1f // Default range sigma of the guide channels
+
+/**
+ * Arguments, set by key=value.
+ * */
+typedef struct {
+    const char *input, *guide, *out;
+    int channels, radius;
+    float sigma_s, sigma_c;
+} joint_params;
+
+// Sets the parameter of one key=value argument, or returns -1
+static int joint_option(joint_params *p, const char *arg){
+    const char *value;
+
+    if ((value = option_value(arg, "input"))) {
+        p->input = value;
+    } else if ((value = option_value(arg, "guide"))) {
+        p->guide = value;
+    } else if ((value = option_value(arg, "channels"))) {
+        p->channels = atoi(value);
+    } else if ((value = option_value(arg, "sigma_s"))) {
+        p->sigma_s = (float) atof(value);
+    } else if ((value = option_value(arg, "sigma_c"))) {
+        p->sigma_c = (float) atof(value);
+    } else if ((value = option_value(arg, "radius"))) {
+        p->radius = atoi(value);
+    } else if ((value = option_value(arg, "out"))) {
+        p->out = value;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/***********************************************************
+ * Function:  main
+ * *********************************************************/
+int main(int argc, char *argv[]){
+    joint_params p = {INPUT_FILE, NULL, NULL, 0, 0, 0.0f, JOINT_SIGMA_C};
+    float gaussian[FILTER_SIZE], sigma_r[LATTICE_MAX_CHANNELS];
+    float *depth, *guide, *lattice, *direct;
+    int size_x = 0, size_y = 0, channels, c, failed = 0;
+    long i, pixels, valid = 0;
+    double lattice_ms, direct_ms, mse = 0.0, diff, max_diff = 0.0;
+    FILE *fptr;
+
+    if (argc > 2) {
+        size_x = atoi(argv[1]);
+        size_y = atoi(argv[2]);
+    }
+    for (c = 3; c < argc && !failed; c++) {
+        failed = joint_option(&p, argv[c]);
+    }
+    if (failed || size_x < 1 || size_y < 1 || (p.guide && (p.channels < 1 || p.channels > LATTICE_MAX_CHANNELS)) ||
+        p.sigma_s < 0 || p.sigma_c <= 0 || p.radius < 0) {
+        printf("Usage: %s <width> <height> [key=value ...]\n", argv[0]);
+        printf("  input=<file>     depth frame (%s)\n", INPUT_FILE);
+        printf("  guide=<file>     guide image, channels floats per pixel (the depth frame)\n");
+        printf("  channels=<N>     guide channels, 1 to %d\n", LATTICE_MAX_CHANNELS);
+        printf("  sigma_s=<px>     spatial sigma (of the filter vector)\n");
+        printf("  sigma_c=<v>      range sigma of the guide channels (%g)\n", JOINT_SIGMA_C);
+        printf("  radius=<px>      brute force window radius (2 sigma_s)\n");
+        printf("  out=<file>       writes the lattice output\n");
+        return EXIT_FAILURE;
+    }
+
+    make_gaussian(gaussian);
+    if (p.sigma_s == 0.0f) {
+        p.sigma_s = filter_sigma_s(gaussian, FILTER_RADIUS);
+    }
+    if (p.radius == 0) {
+        p.radius = (int) ceilf(2.0f * p.sigma_s);
+    }
+    channels = p.guide ? p.channels : 1;
+    for (c = 0; c < channels; c++) {
+        sigma_r[c] = p.guide ? p.sigma_c : FILTER_SIGMA_R;
+    }
+
+    pixels = (long) size_x * size_y;
+    depth = (float*) frame_alloc(sizeof(float) * pixels);
+    lattice = (float*) frame_alloc(sizeof(float) * pixels);
+    direct = (float*) frame_alloc(sizeof(float) * pixels);
+    guide = p.guide ? (float*) frame_alloc(sizeof(float) * pixels * channels) : depth;
+    if (read_floats(p.input, depth, pixels) != 0 || (p.guide && read_floats(p.guide, guide, pixels * channels) != 0)) {
+        return EXIT_FAILURE;
+    }
+
+    trace_start(getenv("FILTER_TRACE"));
+    printf("joint:\t%dx%d\td = %d\tsigma_s %g px\trange sigma %g\n", size_x, size_y, 2 + channels, p.sigma_s,
+           sigma_r[0]);
+    trace_begin("lattice");
+    if (lattice_filter(lattice, depth, guide, channels, size_x, size_y, p.sigma_s, sigma_r) != 0) {
+        return EXIT_FAILURE;
+    }
+    lattice_ms = trace_end();
+    trace_begin("direct");
+    joint_bilateral_direct(direct, depth, guide, channels, size_x, size_y, p.sigma_s, sigma_r, p.radius);
+    direct_ms = trace_end();
+    trace_stop();
+
+    for (i = 0; i < pixels; i++) {
+        if (depth[i] != 0) {
+            diff = lattice[i] - direct[i];
+            mse += diff * diff;
+            max_diff = MAX(max_diff, fabs(diff));
+            valid++;
+        }
+    }
+    mse = valid ? mse / valid : 0.0;
+    printf("lattice:\t%.3f ms\n", lattice_ms);
+    printf("direct:\t%.3f ms\t%d taps per pixel\n", direct_ms, (2 * p.radius + 1) * (2 * p.radius + 1));
+    printf("speedup:\t%.2fx\n", direct_ms / lattice_ms);
+    printf("lattice vs direct:\tMSE %.6g\tRMSE %.3f mm\tmax %.3f mm\n", mse, sqrt(mse) * DEPTH_UNITS,
+           max_diff * DEPTH_UNITS);
+
+    if (p.out) {
+        if ((fptr = fopen(p.out, "wb")) == NULL || fwrite(lattice, sizeof(float), pixels, fptr) != (size_t) pixels) {
+            printf("Error: Failed to write %s\n", p.out);
+            failed = 1;
+        }
+        if (fptr) {
+            fclose(fptr);
+        }
+    }
+
+    free(depth);
+    free(lattice);
+    free(direct);
+    if (guide != depth) {
+        free(guide);
+    }
+    return failed ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,394 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include "filterCommon.h"
+#include "filterBackend.h"
+#include "filterLattice.h"
+#include "filterTrace.h"
+
+/***********************************************************
+ * Permutohedral lattice of filterLattice.h, and the
+ * "lattice" backend, which filters the depth frames guided
+ * by themselves: a plain bilateral filter of d = 3 without
+ * a radius.
+ *
+ * The splat finds the simplex and barycentric weights of
+ * every pixel in parallel; the vertices are then inserted
+ * into the hash table in pixel order, by one thread, and the
+ * pixels accumulated onto them. The blur of every axis and
+ * the slice run in parallel.
+ * *********************************************************/
+
+#define LATTICE_MAX_D (2 + LATTICE_MAX_CHANNELS) // Most dimensions of the space
+
+/**
+ * Vertices of the lattice: d coordinates each (the d + 1st
+ * is minus their sum), in an open addressing hash table of
+ * vertex indices, -1 if free.
+ * */
+typedef struct {
+    int d;
+    short *keys;
+    int count, capacity;
+    int *table;
+    int table_size;
+} lattice_hash;
+
+static unsigned lattice_key_hash(const short *key, int d){
+    unsigned h = 0;
+    int i;
+
+    for (i = 0; i < d; i++) {
+        h = (h + key[i]) * 2531011u;
+    }
+    return h;
+}
+
+// Index of key, or -1
+static int lattice_find(const lattice_hash *hash, const short *key){
+    unsigned slot = lattice_key_hash(key, hash->d) & (hash->table_size - 1);
+    int v;
+
+    while ((v = hash->table[slot]) >= 0) {
+        if (memcmp(hash->keys + (size_t) v * hash->d, key, sizeof(short) * hash->d) == 0) {
+            return v;
+        }
+        slot = (slot + 1) & (hash->table_size - 1);
+    }
+    return -1;
+}
+
+// Doubles the table and the key store. Returns 0 on success
+static int lattice_grow(lattice_hash *hash){
+    int size = hash->table_size ? 2 * hash->table_size : 1024;
+    int *table = (int *) malloc(sizeof(int) * size);
+    short *keys = (short *) realloc(hash->keys, sizeof(short) * hash->d * (size / 2));
+    unsigned slot;
+    int v;
+
+    if (table == NULL || keys == NULL) {
+        free(table);
+        return -1;
+    }
+    memset(table, -1, sizeof(int) * size);
+    hash->keys = keys;
+    for (v = 0; v < hash->count; v++) {
+        slot = lattice_key_hash(keys + (size_t) v * hash->d, hash->d) & (size - 1);
+        while (table[slot] >= 0) {
+            slot = (slot + 1) & (size - 1);
+        }
+        table[slot] = v;
+    }
+    free(hash->table);
+    hash->table = table;
+    hash->table_size = size;
+    hash->capacity = size / 2;
+    return 0;
+}
+
+// Index of key, inserted if new, or -1 if memory runs out
+static int lattice_insert(lattice_hash *hash, const short *key){
+    unsigned slot;
+    int v;
+
+    if (hash->count == hash->capacity && lattice_grow(hash) != 0) {
+        return -1;
+    }
+    slot = lattice_key_hash(key, hash->d) & (hash->table_size - 1);
+    while ((v = hash->table[slot]) >= 0) {
+        if (memcmp(hash->keys + (size_t) v * hash->d, key, sizeof(short) * hash->d) == 0) {
+            return v;
+        }
+        slot = (slot + 1) & (hash->table_size - 1);
+    }
+    v = hash->count++;
+    memcpy(hash->keys + (size_t) v * hash->d, key, sizeof(short) * hash->d);
+    hash->table[slot] = v;
+    return v;
+}
+
+/***********************************************************
+ * Function:  lattice_simplex
+ * ---------------------------------------------------------
+ * Embeds the d dimensional position in the lattice plane,
+ * finds the nearest remainder-0 point and the ranks of the
+ * coordinates, and from them the d + 1 vertices (keys,
+ * d each) and barycentric weights of the enclosing simplex.
+ * *********************************************************/
+static void lattice_simplex(short *keys, float *weights, const float *position, int d){
+    float elevated[LATTICE_MAX_D + 1], bary[LATTICE_MAX_D + 2];
+    int greedy[LATTICE_MAX_D + 1], rank[LATTICE_MAX_D + 1];
+    float scale, v, up, down;
+    int i, j, sum = 0, remainder;
+
+    // Scaled so that the blur of every axis gives a unit Gaussian
+    for (i = d; i >= 0; i--) {
+        elevated[i] = 0.0f;
+    }
+    for (i = d - 1; i >= 0; i--) {
+        scale = (d + 1) * sqrtf(2.0f / 3.0f) / sqrtf((float) (i + 1) * (i + 2));
+        v = position[i] * scale;
+        elevated[i + 1] -= (i + 1) * v;
+        for (j = 0; j <= i; j++) {
+            elevated[j] += v;
+        }
+    }
+
+    for (i = 0; i <= d; i++) {
+        v = elevated[i] / (d + 1);
+        up = ceilf(v) * (d + 1);
+        down = floorf(v) * (d + 1);
+        greedy[i] = (int) (up - elevated[i] < elevated[i] - down ? up : down);
+        sum += greedy[i];
+        rank[i] = 0;
+    }
+    sum /= d + 1;
+
+    for (i = 0; i < d; i++) {
+        for (j = i + 1; j <= d; j++) {
+            if (elevated[i] - greedy[i] < elevated[j] - greedy[j]) {
+                rank[i]++;
+            } else {
+                rank[j]++;
+            }
+        }
+    }
+    for (i = 0; i <= d; i++) {
+        if (sum > 0 && rank[i] >= d + 1 - sum) {
+            greedy[i] -= d + 1;
+            rank[i] += sum - (d + 1);
+        } else if (sum < 0 && rank[i] < -sum) {
+            greedy[i] += d + 1;
+            rank[i] += d + 1 + sum;
+        } else {
+            rank[i] += sum;
+        }
+    }
+
+    for (i = 0; i <= d + 1; i++) {
+        bary[i] = 0.0f;
+    }
+    for (i = 0; i <= d; i++) {
+        v = (elevated[i] - greedy[i]) / (d + 1);
+        bary[d - rank[i]] += v;
+        bary[d + 1 - rank[i]] -= v;
+    }
+    bary[0] += 1.0f + bary[d + 1];
+
+    // Vertex remainder: greedy plus the canonical simplex offset
+    for (remainder = 0; remainder <= d; remainder++) {
+        for (i = 0; i < d; i++) {
+            keys[remainder * d + i] = (short) (greedy[i] + (rank[i] <= d - remainder ? remainder :
+                                                            remainder - (d + 1)));
+        }
+        weights[remainder] = bary[remainder];
+    }
+}
+
+/***********************************************************
+ * Function:  lattice_filter
+ * ---------------------------------------------------------
+ * Every vertex holds a homogeneous (depth sum, weight) pair,
+ * so the slice divides out the weights, and with them the
+ * invalid pixels and the lattice density.
+ * *********************************************************/
+int lattice_filter(float *out, const float *values, const float *guide, int channels, int size_x, int size_y,
+                   float sigma_s, const float *sigma_r){
+    const int d = 2 + channels;
+    const long pixels = (long) size_x * size_y;
+    lattice_hash hash = {d, NULL, 0, 0, NULL, 0};
+    short *keys = NULL;
+    float *weights = NULL, *sums = NULL, *blurred = NULL, *swap;
+    int *vertices = NULL;
+    int axis, failed = 0;
+    long p, v;
+
+    if (channels < 0 || channels > LATTICE_MAX_CHANNELS) {
+        printf("Error: %d guide channels, the lattice takes up to %d\n", channels, LATTICE_MAX_CHANNELS);
+        return -1;
+    }
+    // Keys are shorts, about (d + 1) times the position
+    if (sigma_s <= 0.0f || MAX(size_x, size_y) / sigma_s * (d + 1) > SHRT_MAX) {
+        printf("Error: spatial sigma %f is too small for the lattice\n", sigma_s);
+        return -1;
+    }
+    keys = (short *) malloc(sizeof(short) * pixels * (d + 1) * d);
+    weights = (float *) malloc(sizeof(float) * pixels * (d + 1));
+    vertices = (int *) malloc(sizeof(int) * pixels * (d + 1));
+    if (keys == NULL || weights == NULL || vertices == NULL) {
+        printf("Error: Failed to allocate the lattice splat\n");
+        failed = 1;
+        goto done;
+    }
+
+    trace_begin("splat");
+    #pragma omp parallel for schedule(static)
+    for (p = 0; p < pixels; p++) {
+        float position[LATTICE_MAX_D];
+        int c;
+
+        position[0] = (p % size_x) / sigma_s;
+        position[1] = (p / size_x) / sigma_s;
+        for (c = 0; c < channels; c++) {
+            position[2 + c] = guide[p * channels + c] / sigma_r[c];
+        }
+        lattice_simplex(keys + p * (d + 1) * d, weights + p * (d + 1), position, d);
+    }
+    for (p = 0; p < pixels * (d + 1) && !failed; p++) {
+        vertices[p] = values[p / (d + 1)] != 0 ? lattice_insert(&hash, keys + p * d) : -1;
+        failed = values[p / (d + 1)] != 0 && vertices[p] < 0;
+    }
+    trace_end();
+    if (failed) {
+        printf("Error: Failed to allocate the lattice hash table\n");
+        goto done;
+    }
+
+    sums = (float *) calloc((size_t) hash.count * 2, sizeof(float));
+    blurred = (float *) malloc(sizeof(float) * hash.count * 2);
+    if (sums == NULL || blurred == NULL) {
+        printf("Error: Failed to allocate the lattice vertices\n");
+        failed = 1;
+        goto done;
+    }
+    for (p = 0; p < pixels * (d + 1); p++) {
+        if (vertices[p] >= 0) {
+            sums[2 * vertices[p]] += weights[p] * values[p / (d + 1)];
+            sums[2 * vertices[p] + 1] += weights[p];
+        }
+    }
+
+    // [1 2 1] / 4 along every axis, the neighbours along axis
+    // j being the key plus or minus (1, .., 1, -d, 1, .., 1)
+    trace_begin("blur");
+    for (axis = 0; axis <= d; axis++) {
+        #pragma omp parallel for schedule(static)
+        for (v = 0; v < hash.count; v++) {
+            short n1[LATTICE_MAX_D], n2[LATTICE_MAX_D];
+            const short *key = hash.keys + v * d;
+            int i, a, b;
+
+            for (i = 0; i < d; i++) {
+                n1[i] = key[i] + 1;
+                n2[i] = key[i] - 1;
+            }
+            if (axis < d) {
+                n1[axis] = key[axis] - d;
+                n2[axis] = key[axis] + d;
+            }
+            a = lattice_find(&hash, n1);
+            b = lattice_find(&hash, n2);
+            for (i = 0; i < 2; i++) {
+                blurred[2 * v + i] = 0.5f * sums[2 * v + i] + 0.25f * ((a >= 0 ? sums[2 * a + i] : 0.0f) +
+                                                                     (b >= 0 ? sums[2 * b + i] : 0.0f));
+            }
+        }
+        swap = sums;
+        sums = blurred;
+        blurred = swap;
+    }
+    trace_end();
+
+    trace_begin("slice");
+    #pragma omp parallel for schedule(static)
+    for (p = 0; p < pixels; p++) {
+        float sum = 0.0f, weight = 0.0f;
+        int r;
+
+        if (values[p] == 0) {
+            out[p] = 0.0f;
+            continue;
+        }
+        for (r = 0; r <= d; r++) {
+            const int vertex = vertices[p * (d + 1) + r];
+            sum += weights[p * (d + 1) + r] * sums[2 * vertex];
+            weight += weights[p * (d + 1) + r] * sums[2 * vertex + 1];
+        }
+        out[p] = weight > 0.0f ? sum / weight : values[p];
+    }
+    trace_end();
+
+done:
+    free(keys);
+    free(weights);
+    free(vertices);
+    free(sums);
+    free(blurred);
+    free(hash.keys);
+    free(hash.table);
+    return failed ? -1 : 0;
+}
+
+/***********************************************************
+ * Function:  joint_bilateral_direct
+ * *********************************************************/
+void joint_bilateral_direct(float *out, const float *values, const float *guide, int channels, int size_x,
+                            int size_y, float sigma_s, const float *sigma_r, int radius){
+    int y;
+
+    #pragma omp parallel for schedule(dynamic, 4)
+    for (y = 0; y < size_y; y++) {
+        int x, i, j, c;
+
+        for (x = 0; x < size_x; x++) {
+            const long p = (long) y * size_x + x;
+            float sum = 0.0f, weight = 0.0f;
+
+            if (values[p] == 0) {
+                out[p] = 0.0f;
+                continue;
+            }
+            for (j = MAX(0, y - radius); j <= MIN(size_y - 1, y + radius); j++) {
+                for (i = MAX(0, x - radius); i <= MIN(size_x - 1, x + radius); i++) {
+                    const long q = (long) j * size_x + i;
+                    float e = ((i - x) * (i - x) + (j - y) * (j - y)) / (2.0f * sigma_s * sigma_s);
+
+                    if (values[q] == 0) {
+                        continue;
+                    }
+                    for (c = 0; c < channels; c++) {
+                        const float diff = (guide[q * channels + c] - guide[p * channels + c]) / sigma_r[c];
+                        e += 0.5f * diff * diff;
+                    }
+                    sum += expf(-e) * values[q];
+                    weight += expf(-e);
+                }
+            }
+            out[p] = sum / weight;
+        }
+    }
+}
+
+static int lattice_open(const char *xclbin){
+    return 0;
+}
+
+static void lattice_close(void){
+}
+
+/***********************************************************
+ * Function:  lattice_backend_filter
+ * ---------------------------------------------------------
+ * Every frame is its own guide, in units of FILTER_SIGMA_R.
+ * *********************************************************/
+static int lattice_backend_filter(float *out, const float *in, const float *gaussian, int size_x, int size_y, int r,
+                                  int frames){
+    const float sigma_r = FILTER_SIGMA_R;
+    const float sigma_s = filter_sigma_s(gaussian, r);
+    int f;
+
+    for (f = 0; f < frames; f++) {
+        trace_begin("frame");
+        if (lattice_filter(out + (long) f * size_x * size_y, in + (long) f * size_x * size_y,
+                           in + (long) f * size_x * size_y, 1, size_x, size_y, sigma_s, &sigma_r) != 0) {
+            trace_end();
+            return -1;
+        }
+        trace_end();
+    }
+    return 0;
+}
+
+const filter_backend lattice_backend = {"lattice", lattice_open, lattice_backend_filter, NULL, lattice_close, 0};
@@ -0,0 +1,38 @@
+#ifndef _FILTER_LATTICE_H_
+#define _FILTER_LATTICE_H_
+
+/***********************************************************
+ * Joint bilateral filtering of a depth frame guided by an
+ * image of any number of channels (e.g. RGB): every pixel
+ * is a point (x / sigma_s, y / sigma_s, g_c / sigma_r[c])
+ * of a 2 + channels dimensional space, and the filter is a
+ * Gaussian blur of the depths in that space.
+ *
+ * lattice_filter() blurs on the permutohedral lattice
+ * (Adams, Baek, Davis, Eurographics 2010): splat every pixel
+ * onto the d + 1 vertices of its enclosing simplex, kept in
+ * a hash table, blur along the d + 1 lattice axes, slice
+ * back at the pixels. Its cost grows linearly with d, the
+ * direct filter's with the window area times the channels.
+ *
+ * joint_bilateral_direct() is the brute force reference,
+ * over a (2 radius + 1)^2 window.
+ *
+ * Guides hold channels interleaved floats per pixel, row by
+ * row. Zero depths are invalid, as in the direct kernel:
+ * they carry no weight and their output is zero.
+ * *********************************************************/
+
+#define LATTICE_MAX_CHANNELS 8 // Most guide channels
+
+// Filters values with the lattice. Returns 0 on success, -1
+// if the channels are out of range or memory runs out.
+int lattice_filter(float *out, const float *values, const float *guide, int channels, int size_x, int size_y,
+                   float sigma_s, const float *sigma_r);
+
+// Filters values directly, with Gaussian spatial and range
+// weights truncated at radius pixels
+void joint_bilateral_direct(float *out, const float *values, const float *guide, int channels, int size_x,
+                            int size_y, float sigma_s, const float *sigma_r, int radius);
+
+#endif
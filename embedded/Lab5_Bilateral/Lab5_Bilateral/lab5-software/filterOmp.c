@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "filterCommon.h"
+#include "filterOmp.h"
+#include "filterTrace.h"
+#include "filterPerf.h"
+#include "filterStats.h"
+
+/***********************************************************
+ * Function:  bilateralFilterRowTaps
+ * ---------------------------------------------------------
+ * See filterOmp.h. Columns are unsigned, so a tap left of
+ * the image wraps around and is clamped to the last column,
+ * as in the reference output. The counters build counts
+ * every pixel and tap into the tile of STATS_ROW().
+ * *********************************************************/
+void bilateralFilterRowTaps(float* out, const float* const* rows, const float* gaussian, int size_x, int r,
+                            int x_begin, int x_end) {
+        // Local Variables
+        int i,j;
+		unsigned int x;
+		const float* in = rows[r];
+
+			for (x = x_begin; x < (unsigned int) x_end; x++) {
+#ifdef FILTER_STATS
+				filter_stats* stats = stats_tile(stats_frame_index, x, stats_row_index);
+				stats->pixels++;
+#endif
+				if (in[x] == 0) {
+#ifdef FILTER_STATS
+					stats->zero_pixels++;
+#endif
+					out[x] = 0;
+					continue;
+				}
+
+				float sum = 0.0f;
+				float t = 0.0f;
+
+				const float center = in[x];
+
+				for (i = -r; i <= r; ++i) {
+					for (j = -r; j <= r; ++j) {
+						unsigned int curPos_x = MAX(0u, MIN(x + i,size_x - 1));
+
+						const float curPix = rows[j + r][curPos_x];
+#ifdef FILTER_STATS
+						stats->taps++;
+						stats->rejected_taps += curPix <= 0;
+#endif
+						if (curPix > 0) {
+							const float mod = pow(curPix - center,2);
+#ifdef FILTER_STATS
+							stats_weight(stats, expf(-mod / 0.02f));
+#endif
+							const float factor = gaussian[i + r]
+									* gaussian[j + r]
+									* expf(-mod / 0.02f);
+							t += factor * curPix;
+							sum += factor;
+						}
+					}
+				}
+				out[x] = t / sum;
+			}
+}
+
+/***********************************************************
+ * Function:  bilateralFilterRow
+ * ---------------------------------------------------------
+ * See filterOmp.h. Rows are unsigned too, so a tap above the
+ * image wraps around and is clamped to the last row.
+ * *********************************************************/
+void bilateralFilterRow(float* out, const float* in, const float* gaussian, int size_x, int size_y, int r,
+                        int row, int x_begin, int x_end) {
+        const float* rows[2 * FILTER_MAX_RADIUS + 1];
+        const unsigned int y = row;
+        int j;
+
+        for (j = -r; j <= r; ++j) {
+            rows[j + r] = in + MIN(y + j, (unsigned int) size_y - 1) * size_x;
+        }
+        STATS_ROW(row);
+        bilateralFilterRowTaps(out + y * size_x, rows, gaussian, size_x, r, x_begin, x_end);
+}
+
+/***********************************************************
+ * Function:  bilateralFilterBand
+ * ---------------------------------------------------------
+ * See filterOmp.h. The rows of the band are shared between
+ * the OpenMP threads, each tracing and counting its share
+ * as one span.
+ * *********************************************************/
+void bilateralFilterBand(float* out, const float* in, const float* gaussian, int size_x, int size_y, int r,
+                         int row_begin, int row_end) {
+        #pragma omp parallel shared(out)
+        {
+            int y, filtered = 0;
+
+            trace_begin("rows");
+            perf_begin(PERF_ROWS);
+            #pragma omp for schedule(static) nowait
+            for (y = row_begin; y < row_end; y++) {
+                bilateralFilterRow(out, in, gaussian, size_x, size_y, r, y, 0, size_x);
+                filtered++;
+            }
+            perf_end(PERF_ROWS, (long) filtered * size_x);
+            trace_end();
+        }
+}
+
+/***********************************************************
+ * Function:  bilateralFilterBandU16
+ * ---------------------------------------------------------
+ * See filterOmp.h. Every thread converts the rows of one
+ * tile, and the r rows around it, into its own scratch tile,
+ * then filters the tile from there while it is in cache.
+ * *********************************************************/
+void bilateralFilterBandU16(float* out, const uint16_t* in, const float* gaussian, int size_x, int size_y, int r,
+                            int row_begin, int row_end) {
+        int tiles = (row_end - row_begin + DEPTH_TILE_ROWS - 1) / DEPTH_TILE_ROWS;
+
+        #pragma omp parallel shared(out)
+        {
+            const float* rows[2 * FILTER_MAX_RADIUS + 1];
+            float* tile = (float*) malloc(sizeof(float) * size_x * (DEPTH_TILE_ROWS + 2 * r));
+            int t, y, y0, y1, j, filtered = 0;
+
+            if (tile == NULL) {
+                printf("Error: Failed to allocate a depth tile\n");
+                exit(EXIT_FAILURE);
+            }
+            perf_begin(PERF_ROWS);
+            #pragma omp for schedule(static) nowait
+            for (t = 0; t < tiles; t++) {
+                y0 = row_begin + t * DEPTH_TILE_ROWS;
+                y1 = MIN(y0 + DEPTH_TILE_ROWS, row_end);
+                trace_begin("tile");
+                depth_rows(tile, in, size_x, size_y, y0 - r, y1 - y0 + 2 * r);
+                for (y = y0; y < y1; y++) {
+                    for (j = 0; j <= 2 * r; j++) {
+                        rows[j] = tile + (y - y0 + j) * size_x;
+                    }
+                    STATS_ROW(y);
+                    bilateralFilterRowTaps(out + y * size_x, rows, gaussian, size_x, r, 0, size_x);
+                }
+                filtered += y1 - y0;
+                trace_end();
+            }
+            perf_end(PERF_ROWS, (long) filtered * size_x);
+            free(tile);
+        }
+}
@@ -0,0 +1,60 @@
+#ifndef _FILTER_OMP_H_
+#define _FILTER_OMP_H_
+
+/***********************************************************
+ * OpenMP bilateral filter of the software host (filter.c).
+ * The hardware host links it too (make CPU=yes in
+ * lab5-hardware), to filter part of every frame on the ARM
+ * cores while the FPGA filters the rest.
+ * *********************************************************/
+
+#include <stdint.h>
+
+#define FILTER_MAX_RADIUS 8 // Largest radius of the row routines
+
+/***********************************************************
+ * Function:  bilateralFilterRowTaps
+ * ---------------------------------------------------------
+ * Applies the filter on pixels [x_begin, x_end) of one row,
+ * one at a time, into out (the output row). rows[j + r] is
+ * the input row j rows below it, border rows already
+ * resolved, so the rows may come from a whole frame or from
+ * a converted tile. r <= FILTER_MAX_RADIUS.
+ * *********************************************************/
+void bilateralFilterRowTaps(float* out, const float* const* rows, const float* gaussian, int size_x, int r,
+                            int x_begin, int x_end);
+
+/***********************************************************
+ * Function:  bilateralFilterRow
+ * ---------------------------------------------------------
+ * Applies the filter on pixels [x_begin, x_end) of row y,
+ * one at a time. The OpenMP band and the scalar backend use
+ * it. r <= FILTER_MAX_RADIUS.
+ * *********************************************************/
+void bilateralFilterRow(float* out, const float* in, const float* gaussian, int size_x, int size_y, int r,
+                        int y, int x_begin, int x_end);
+
+/***********************************************************
+ * Function:  bilateralFilterBand
+ * ---------------------------------------------------------
+ * Applies the filter on rows [row_begin, row_end) of a
+ * size_x x size_y image. in holds the whole image, so the
+ * rows around the band are read as needed; only the band
+ * rows of out are written.
+ * *********************************************************/
+void bilateralFilterBand(float* out, const float* in, const float* gaussian, int size_x, int size_y, int r,
+                         int row_begin, int row_end);
+
+/***********************************************************
+ * Function:  bilateralFilterBandU16
+ * ---------------------------------------------------------
+ * bilateralFilterBand on a uint16 depth image, converted to
+ * metres tile by tile (DEPTH_TILE_ROWS rows) as it is
+ * filtered, so no float copy of the whole image is written
+ * or read back. Gives the output of bilateralFilterBand on
+ * the converted image.
+ * *********************************************************/
+void bilateralFilterBandU16(float* out, const uint16_t* in, const float* gaussian, int size_x, int size_y, int r,
+                            int row_begin, int row_end);
+
+#endif
@@ -0,0 +1,229 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "filterPerf.h"
+
+#define CACHE_EVENT(cache, op, result) ((cache) | ((op) << 8) | ((result) << 16))
+
+// Counters opened on every thread
+enum {
+    COUNTER_TASK_CLOCK,
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_LOADS,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_REFERENCES,
+    COUNTER_LLC_MISSES,
+    COUNTER_BRANCHES,
+    COUNTER_BRANCH_MISSES,
+    COUNTERS
+};
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} counter_events[COUNTERS] = {
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                                     PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+    {PERF_TYPE_HW_CACHE, CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                                     PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+static const char *phase_names[PERF_PHASES] = {"load", "filter", "rows", "compare"};
+
+/**
+ * Counts of one phase on one thread. Only its thread writes
+ * it. A count is negative if its counter is not available.
+ * */
+typedef struct {
+    double counts[COUNTERS];
+    long pixels;
+    int runs;
+} perf_counts;
+
+static int perf_on;
+static int perf_threads;
+static perf_counts perf_table[PERF_PHASES][PERF_MAX_THREADS];
+
+// Counters of the calling thread, and their values when each phase began
+static __thread int thread_index = -1;
+static __thread int thread_fds[COUNTERS];
+static __thread double thread_starts[PERF_PHASES][COUNTERS];
+
+/***********************************************************
+ * Function:  perf_start
+ * *********************************************************/
+void perf_start(void){
+    perf_on = getenv("FILTER_PERF") != NULL;
+}
+
+/***********************************************************
+ * Function:  perf_reset
+ * *********************************************************/
+void perf_reset(void){
+    memset(perf_table, 0, sizeof(perf_table));
+}
+
+// Opens the counters of the calling thread, user space only
+static void perf_open_thread(void){
+    struct perf_event_attr attr;
+    int c;
+
+    thread_index = __sync_fetch_and_add(&perf_threads, 1);
+    for (c = 0; c < COUNTERS; c++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counter_events[c].type;
+        attr.config = counter_events[c].config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        thread_fds[c] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (thread_fds[c] < 0 && thread_index == 0 && c == COUNTER_CYCLES) {
+            printf("perf: no hardware counters (%s), only task ms is counted\n", strerror(errno));
+        }
+    }
+}
+
+/***********************************************************
+ * Function:  perf_read
+ * ---------------------------------------------------------
+ * Value of counter c of the calling thread, scaled up if the
+ * kernel multiplexed it with other counters, or -1.
+ * *********************************************************/
+static double perf_read(int c){
+    uint64_t values[3];
+
+    if (thread_fds[c] < 0 || read(thread_fds[c], values, sizeof(values)) != sizeof(values)) {
+        return -1.0;
+    }
+    if (values[2] == 0) {
+        return 0.0;
+    }
+    return (double) values[0] * values[1] / values[2];
+}
+
+/***********************************************************
+ * Function:  perf_begin
+ * *********************************************************/
+void perf_begin(int phase){
+    int c;
+
+    if (!perf_on) {
+        return;
+    }
+    if (thread_index < 0) {
+        perf_open_thread();
+    }
+    for (c = 0; c < COUNTERS; c++) {
+        thread_starts[phase][c] = perf_read(c);
+    }
+}
+
+/***********************************************************
+ * Function:  perf_end
+ * *********************************************************/
+void perf_end(int phase, long pixels){
+    perf_counts *counts;
+    double value;
+    int c;
+
+    if (!perf_on || thread_index < 0 || thread_index >= PERF_MAX_THREADS) {
+        return;
+    }
+    counts = &perf_table[phase][thread_index];
+    for (c = 0; c < COUNTERS; c++) {
+        value = perf_read(c);
+        if (value < 0 || thread_starts[phase][c] < 0 || counts->counts[c] < 0) {
+            counts->counts[c] = -1.0;
+        } else {
+            counts->counts[c] += value - thread_starts[phase][c];
+        }
+    }
+    counts->pixels += pixels;
+    counts->runs++;
+}
+
+// Prints a / b scaled, or n/a if either count is not available
+static void perf_ratio(double a, double b, double scale, const char *format){
+    if (a < 0 || b <= 0) {
+        printf("\tn/a");
+    } else {
+        printf(format, a / b * scale);
+    }
+}
+
+// Prints one line of the report
+static void perf_line(const char *phase, const char *thread, const perf_counts *counts){
+    const double *n = counts->counts;
+
+    printf("\t\t%s\t%s\t%.2f", phase, thread, n[COUNTER_TASK_CLOCK] < 0 ? 0.0 : n[COUNTER_TASK_CLOCK] / 1e6);
+    if (n[COUNTER_CYCLES] < 0) {
+        printf("\tn/a");
+    } else {
+        printf("\t%.3g", n[COUNTER_CYCLES]);
+    }
+    perf_ratio(n[COUNTER_INSTRUCTIONS], n[COUNTER_CYCLES], 1.0, "\t%.2f");
+    perf_ratio(n[COUNTER_L1D_MISSES], n[COUNTER_L1D_LOADS], 100.0, "\t%.2f%%");
+    perf_ratio(n[COUNTER_LLC_MISSES], n[COUNTER_LLC_REFERENCES], 100.0, "\t%.2f%%");
+    perf_ratio(n[COUNTER_BRANCH_MISSES], n[COUNTER_BRANCHES], 100.0, "\t%.2f%%");
+    perf_ratio(n[COUNTER_LLC_MISSES], (double) counts->pixels, PERF_LINE_BYTES, "\t%.2f");
+    printf("\n");
+}
+
+/***********************************************************
+ * Function:  perf_report
+ * ---------------------------------------------------------
+ * Bytes per pixel counts one cache line of memory traffic
+ * per last level miss. A phase total sums its threads; a
+ * count missing on one thread is missing in the total.
+ * *********************************************************/
+void perf_report(void){
+    perf_counts total;
+    char thread[16];
+    int p, t, c, threads, used;
+
+    if (!perf_on) {
+        return;
+    }
+    threads = perf_threads < PERF_MAX_THREADS ? perf_threads : PERF_MAX_THREADS;
+    printf("perf:\t\tphase\tthread\ttask ms\tcycles\tIPC\tL1D miss\tLLC miss\tbranch miss\tbytes/pixel\n");
+    for (p = 0; p < PERF_PHASES; p++) {
+        memset(&total, 0, sizeof(total));
+        used = 0;
+        for (t = 0; t < threads; t++) {
+            const perf_counts *counts = &perf_table[p][t];
+            if (counts->runs == 0) {
+                continue;
+            }
+            used++;
+            for (c = 0; c < COUNTERS; c++) {
+                total.counts[c] = counts->counts[c] < 0 || total.counts[c] < 0 ? -1.0 :
+                                  total.counts[c] + counts->counts[c];
+            }
+            total.pixels += counts->pixels;
+        }
+        if (used == 0) {
+            continue;
+        }
+        perf_line(phase_names[p], "all", &total);
+        for (t = 0; t < threads && used > 1; t++) {
+            if (perf_table[p][t].runs > 0) {
+                snprintf(thread, sizeof(thread), "%d", t);
+                perf_line(phase_names[p], thread, &perf_table[p][t]);
+            }
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef _FILTER_PERF_H_
+#define _FILTER_PERF_H_
+
+/***********************************************************
+ * Hardware performance counters (Linux perf_event_open) per
+ * phase of a run, to tell whether the filter is compute or
+ * memory bound. Every thread counts its own work with its
+ * own counters, opened the first time it enters a phase, so
+ * a phase run by the OpenMP threads is reported per thread.
+ *
+ * Counting is off unless FILTER_PERF is set in the
+ * environment; perf_begin() and perf_end() then return at
+ * once. Counters the CPU or the kernel does not provide
+ * (e.g. in a VM, or with perf_event_paranoid > 2) are
+ * reported as n/a.
+ *
+ *   FILTER_PERF=1 ./filter openmp 8
+ * *********************************************************/
+
+// Phases of a run
+enum {
+    PERF_LOAD,      // Input and filter vector set up
+    PERF_FILTER,    // Filter call, on the calling thread
+    PERF_ROWS,      // Share of the rows of every OpenMP thread
+    PERF_COMPARE,   // Check against the golden output
+    PERF_PHASES
+};
+
+#define PERF_MAX_THREADS 64 // Threads counted, later ones are not
+#define PERF_LINE_BYTES 64  // Cache line size, bytes per last level miss
+
+// Turns counting on if FILTER_PERF is set
+void perf_start(void);
+
+// Clears the counts of all phases, e.g. between backends
+void perf_reset(void);
+
+// Starts counting phase on the calling thread
+void perf_begin(int phase);
+
+// Stops counting phase on the calling thread, which
+// processed pixels pixels in it
+void perf_end(int phase, long pixels);
+
+// Prints IPC, miss rates and bytes per pixel of every phase,
+// and of every thread of the phases run by several threads
+void perf_report(void);
+
+#endif
@@ -0,0 +1,277 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "filterCommon.h"
+#include "filterBackend.h"
+#include "filterTrace.h"
+
+/***********************************************************
+ * Recursive bilateral filter (Yang, "Recursive Bilateral
+ * Filtering", ECCV 2012): the spatial kernel is a first
+ * order IIR, run causal and anti-causal along every row,
+ * then along every column of the row result. The feedback
+ * of every step is scaled by the range weight between the
+ * two pixels, so the smoothing stops at depth edges. A
+ * frame costs a few operations per pixel whatever the
+ * spatial sigma; the direct kernel costs (2r + 1)^2 taps.
+ *
+ * It approximates the direct filter, it does not match it:
+ * the IIR kernel is exponential, not Gaussian, and has no
+ * radius, and the border taps of the direct kernel (last
+ * row and column) do not exist here. benchmark() of filter.c
+ * reports its MSE against the golden output.
+ *
+ * Zero pixels are invalid, as in the direct kernel: they
+ * add nothing, their output is zero, and the recursion runs
+ * through them, decaying by the spatial factor alone, to
+ * the next valid pixel, with the range weight between the
+ * two valid pixels on either side.
+ *
+ * The spatial sigma is the one of the filter vector, unless
+ * FILTER_SIGMA_S gives one in pixels for wider smoothing
+ * (filter_sigma_s()).
+ * *********************************************************/
+
+#define RECURSIVE_BLOCK 64 // Columns of one vertical pass, contiguous in memory
+#define RECURSIVE_BUFFERS 5 // Frame sized scratch buffers
+
+// Frame sized scratch, grown as needed and freed by close
+static float *scratch;
+static size_t scratch_pixels;
+// Feedback factor of the spatial kernel
+static float recursive_a;
+
+// Range weight of the direct kernel between depths p and q
+static inline float recursive_range(float p, float q){
+    return expf(-(p - q) * (p - q) / 0.02f);
+}
+
+/***********************************************************
+ * Function:  recursive_rows
+ * ---------------------------------------------------------
+ * Horizontal pass: normalized causal plus anti-causal sum of
+ * every row of in into h, zero where in is zero. edge[x] is
+ * the range weight between pixel x and the valid pixel left
+ * of it, 1 without one; both directions use it. The causal
+ * sums and edge weights of every row go to its row of the
+ * frame sized num, den and edge, which the vertical pass
+ * reuses once this one is done.
+ * *********************************************************/
+static void recursive_rows(float *h, const float *in, float *rows_num, float *rows_den, float *rows_edge,
+                           int size_x, int size_y, float a){
+    #pragma omp parallel
+    {
+        float cn, cd, last;
+        int x, y, valid, q;
+
+        trace_begin("rows");
+        #pragma omp for schedule(static)
+        for (y = 0; y < size_y; y++) {
+            const float *row = in + (long) y * size_x;
+            float *out = h + (long) y * size_x;
+            float *num = rows_num + (long) y * size_x;
+            float *den = rows_den + (long) y * size_x;
+            float *edge = rows_edge + (long) y * size_x;
+
+            cn = cd = 0.0f;
+            last = 0.0f;
+            for (x = 0; x < size_x; x++) {
+                valid = row[x] != 0;
+                edge[x] = valid && last != 0 ? recursive_range(row[x], last) : 1.0f;
+                cn = a * edge[x] * cn + (valid ? (1.0f - a) * row[x] : 0.0f);
+                cd = a * edge[x] * cd + (valid ? 1.0f - a : 0.0f);
+                num[x] = cn;
+                den[x] = cd;
+                if (valid) {
+                    last = row[x];
+                }
+            }
+
+            cn = cd = 0.0f;
+            q = -1;
+            for (x = size_x - 1; x >= 0; x--) {
+                valid = row[x] != 0;
+                cn *= a;
+                cd *= a;
+                if (!valid) {
+                    out[x] = 0.0f;
+                    continue;
+                }
+                if (q >= 0) {
+                    cn *= edge[q];
+                    cd *= edge[q];
+                }
+                q = x;
+                // The centre term is in both sums, count it once
+                out[x] = (num[x] + cn) / (den[x] + cd);
+                cn += (1.0f - a) * row[x];
+                cd += 1.0f - a;
+            }
+        }
+        trace_end();
+    }
+}
+
+/***********************************************************
+ * Function:  recursive_columns
+ * ---------------------------------------------------------
+ * Vertical pass over h, with the range weights and validity
+ * of the guide in. Every thread runs blocks of
+ * RECURSIVE_BLOCK columns row by row, so that its loads are
+ * contiguous; num, den and edge hold the causal sums and the
+ * edge weights of the whole frame.
+ * *********************************************************/
+static void recursive_columns(float *out, const float *h, const float *in, float *num, float *den, float *edge,
+                              int size_x, int size_y, float a){
+    int blocks = (size_x + RECURSIVE_BLOCK - 1) / RECURSIVE_BLOCK;
+
+    #pragma omp parallel
+    {
+        float cn[RECURSIVE_BLOCK], cd[RECURSIVE_BLOCK], last[RECURSIVE_BLOCK];
+        int q[RECURSIVE_BLOCK];
+        int b, x, x0, x1, y;
+        long i;
+
+        trace_begin("columns");
+        #pragma omp for schedule(static)
+        for (b = 0; b < blocks; b++) {
+            x0 = b * RECURSIVE_BLOCK;
+            x1 = MIN(x0 + RECURSIVE_BLOCK, size_x);
+            for (x = x0; x < x1; x++) {
+                cn[x - x0] = cd[x - x0] = last[x - x0] = 0.0f;
+                q[x - x0] = -1;
+            }
+            for (y = 0; y < size_y; y++) {
+                for (x = x0; x < x1; x++) {
+                    i = (long) y * size_x + x;
+                    int valid = in[i] != 0;
+                    edge[i] = valid && last[x - x0] != 0 ? recursive_range(in[i], last[x - x0]) : 1.0f;
+                    cn[x - x0] = a * edge[i] * cn[x - x0] + (valid ? (1.0f - a) * h[i] : 0.0f);
+                    cd[x - x0] = a * edge[i] * cd[x - x0] + (valid ? 1.0f - a : 0.0f);
+                    num[i] = cn[x - x0];
+                    den[i] = cd[x - x0];
+                    if (valid) {
+                        last[x - x0] = in[i];
+                    }
+                }
+            }
+            for (x = x0; x < x1; x++) {
+                cn[x - x0] = cd[x - x0] = 0.0f;
+            }
+            for (y = size_y - 1; y >= 0; y--) {
+                for (x = x0; x < x1; x++) {
+                    i = (long) y * size_x + x;
+                    cn[x - x0] *= a;
+                    cd[x - x0] *= a;
+                    if (in[i] == 0) {
+                        out[i] = 0.0f;
+                        continue;
+                    }
+                    if (q[x - x0] >= 0) {
+                        cn[x - x0] *= edge[(long) q[x - x0] * size_x + x];
+                        cd[x - x0] *= edge[(long) q[x - x0] * size_x + x];
+                    }
+                    q[x - x0] = y;
+                    out[i] = (num[i] + cn[x - x0]) / (den[i] + cd[x - x0]);
+                    cn[x - x0] += (1.0f - a) * h[i];
+                    cd[x - x0] += 1.0f - a;
+                }
+            }
+        }
+        trace_end();
+    }
+}
+
+// Frame sized scratch buffer n of RECURSIVE_BUFFERS, or NULL
+static float *recursive_buffer(size_t pixels, int n){
+    if (pixels > scratch_pixels) {
+        free(scratch);
+        scratch = (float *) malloc(sizeof(float) * pixels * RECURSIVE_BUFFERS);
+        scratch_pixels = scratch ? pixels : 0;
+        if (scratch == NULL) {
+            printf("Error: Failed to allocate the recursive filter buffers\n");
+            return NULL;
+        }
+    }
+    return scratch + pixels * n;
+}
+
+/***********************************************************
+ * Function:  recursive_frame
+ * *********************************************************/
+static void recursive_frame(float *out, const float *in, int size_x, int size_y){
+    size_t pixels = (size_t) size_x * size_y;
+
+    recursive_rows(recursive_buffer(pixels, 0), in, recursive_buffer(pixels, 1), recursive_buffer(pixels, 2),
+                   recursive_buffer(pixels, 3), size_x, size_y, recursive_a);
+    recursive_columns(out, recursive_buffer(pixels, 0), in, recursive_buffer(pixels, 1),
+                      recursive_buffer(pixels, 2), recursive_buffer(pixels, 3), size_x, size_y, recursive_a);
+}
+
+static int recursive_open(const char *xclbin){
+    return 0;
+}
+
+static void recursive_close(void){
+    free(scratch);
+    scratch = NULL;
+    scratch_pixels = 0;
+}
+
+// Sets the spatial factor up and the scratch buffers. Returns 0 on success
+static int recursive_setup(const float *gaussian, int size_x, int size_y, int r){
+    float sigma = filter_sigma_s(gaussian, r);
+
+    if (sigma <= 0.0f) {
+        printf("Error: spatial sigma %f is not positive\n", sigma);
+        return -1;
+    }
+    recursive_a = expf(-sqrtf(2.0f) / sigma);
+    return recursive_buffer((size_t) size_x * size_y, 0) ? 0 : -1;
+}
+
+/***********************************************************
+ * Function:  recursive_filter
+ * *********************************************************/
+static int recursive_filter(float *out, const float *in, const float *gaussian, int size_x, int size_y, int r,
+                            int frames){
+    int f;
+
+    if (recursive_setup(gaussian, size_x, size_y, r) != 0) {
+        return -1;
+    }
+    for (f = 0; f < frames; f++) {
+        trace_begin("frame");
+        recursive_frame(out + (long) f * size_x * size_y, in + (long) f * size_x * size_y, size_x, size_y);
+        trace_end();
+    }
+    return 0;
+}
+
+/***********************************************************
+ * Function:  recursive_filter_u16
+ * ---------------------------------------------------------
+ * The passes read every pixel twice, so each frame is
+ * converted to metres once, into the last scratch buffer.
+ * *********************************************************/
+static int recursive_filter_u16(float *out, const uint16_t *in, const float *gaussian, int size_x, int size_y,
+                                int r, int frames){
+    size_t pixels = (size_t) size_x * size_y;
+    float *frame;
+    int f;
+
+    if (recursive_setup(gaussian, size_x, size_y, r) != 0) {
+        return -1;
+    }
+    frame = recursive_buffer(pixels, RECURSIVE_BUFFERS - 1);
+    for (f = 0; f < frames; f++) {
+        trace_begin("frame");
+        depth_rows(frame, in + f * pixels, size_x, size_y, 0, size_y);
+        recursive_frame(out + f * pixels, frame, size_x, size_y);
+        trace_end();
+    }
+    return 0;
+}
+
+const filter_backend recursive_backend = {"recursive", recursive_open, recursive_filter, recursive_filter_u16,
+                                          recursive_close, 0};
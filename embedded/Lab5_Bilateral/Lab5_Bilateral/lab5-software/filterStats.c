@@ -0,0 +1,217 @@
+#ifdef FILTER_STATS
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "filterStats.h"
+
+/**
+ * Counts of one thread, frames x tiles. Only its thread
+ * writes it; the list of tables is shared, under
+ * stats_lock.
+ * */
+typedef struct stats_table {
+    filter_stats *tiles;
+    int frames;
+    struct stats_table *next;
+} stats_table;
+
+int stats_frame_index;
+__thread int stats_row_index;
+
+static int tiles_x = 1, tiles_y = 1;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static stats_table *stats_tables;
+static __thread stats_table *thread_table;
+
+/***********************************************************
+ * Function:  stats_start
+ * *********************************************************/
+void stats_start(int size_x, int size_y){
+    tiles_x = (size_x + STATS_TILE - 1) / STATS_TILE;
+    tiles_y = (size_y + STATS_TILE - 1) / STATS_TILE;
+    stats_reset();
+}
+
+/***********************************************************
+ * Function:  stats_reset
+ * ---------------------------------------------------------
+ * The threads keep their tables, emptied.
+ * *********************************************************/
+void stats_reset(void){
+    stats_table *table;
+
+    pthread_mutex_lock(&stats_lock);
+    for (table = stats_tables; table; table = table->next) {
+        free(table->tiles);
+        table->tiles = NULL;
+        table->frames = 0;
+    }
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/***********************************************************
+ * Function:  stats_tile
+ * ---------------------------------------------------------
+ * Registers the table of the calling thread on first use,
+ * and grows it to frame.
+ * *********************************************************/
+filter_stats *stats_tile(int frame, int x, int y){
+    stats_table *table = thread_table;
+    int tiles = tiles_x * tiles_y;
+
+    if (!table) {
+        table = (stats_table *) calloc(1, sizeof(stats_table));
+        if (table == NULL) {
+            printf("Error: Failed to allocate a stats table\n");
+            exit(EXIT_FAILURE);
+        }
+        pthread_mutex_lock(&stats_lock);
+        table->next = stats_tables;
+        stats_tables = table;
+        pthread_mutex_unlock(&stats_lock);
+        thread_table = table;
+    }
+    if (frame >= table->frames) {
+        table->tiles = (filter_stats *) realloc(table->tiles, sizeof(filter_stats) * tiles * (frame + 1));
+        if (table->tiles == NULL) {
+            printf("Error: Failed to allocate stats tiles\n");
+            exit(EXIT_FAILURE);
+        }
+        memset(table->tiles + tiles * table->frames, 0, sizeof(filter_stats) * tiles * (frame + 1 - table->frames));
+        table->frames = frame + 1;
+    }
+    return &table->tiles[frame * tiles + (y / STATS_TILE) * tiles_x + x / STATS_TILE];
+}
+
+/***********************************************************
+ * Function:  stats_weight
+ * *********************************************************/
+void stats_weight(filter_stats *stats, float w){
+    float decade = 0.1f;
+    int bin = 0;
+
+    while (w < decade && bin < STATS_WEIGHT_BINS - 1) {
+        decade *= 0.1f;
+        bin++;
+    }
+    stats->weight_bins[bin]++;
+    stats->weight_sum += w;
+}
+
+// Adds the counts of b to a
+static void stats_add(filter_stats *a, const filter_stats *b){
+    int i;
+
+    a->pixels += b->pixels;
+    a->zero_pixels += b->zero_pixels;
+    a->taps += b->taps;
+    a->rejected_taps += b->rejected_taps;
+    a->weight_sum += b->weight_sum;
+    for (i = 0; i < STATS_WEIGHT_BINS; i++) {
+        a->weight_bins[i] += b->weight_bins[i];
+    }
+}
+
+static double stats_rate(long a, long b){
+    return b ? 100.0 * a / b : 0.0;
+}
+
+/***********************************************************
+ * Function:  stats_report
+ * ---------------------------------------------------------
+ * Per frame: zero skip rate, rejected tap rate, mean range
+ * weight of the accepted taps, and their share per weight
+ * decade; then the tiles with the highest zero skip and
+ * rejection rates.
+ * *********************************************************/
+void stats_report(void){
+    stats_table *table;
+    filter_stats *merged, frame_total;
+    const filter_stats *tile;
+    const char *csv_path = getenv("FILTER_STATS_CSV");
+    FILE *csv = NULL;
+    int tiles = tiles_x * tiles_y;
+    int frames = 0, f, t, i, zero_tile, rejected_tile;
+    long accepted;
+
+    for (table = stats_tables; table; table = table->next) {
+        frames = table->frames > frames ? table->frames : frames;
+    }
+    if (frames == 0) {
+        return;
+    }
+    merged = (filter_stats *) calloc((size_t) frames * tiles, sizeof(filter_stats));
+    if (merged == NULL) {
+        printf("Error: Failed to allocate stats\n");
+        return;
+    }
+    for (table = stats_tables; table; table = table->next) {
+        for (t = 0; t < table->frames * tiles; t++) {
+            stats_add(&merged[t], &table->tiles[t]);
+        }
+    }
+
+    if (csv_path && (csv = fopen(csv_path, "w")) == NULL) {
+        printf("Error: Failed to open stats file %s\n", csv_path);
+    }
+    if (csv) {
+        fprintf(csv, "frame,tile_x,tile_y,pixels,zero_pixels,taps,rejected_taps,weight_sum");
+        for (i = 0; i < STATS_WEIGHT_BINS - 1; i++) {
+            fprintf(csv, ",weights_ge_1e-%d", i + 1);
+        }
+        fprintf(csv, ",weights_lt_1e-%d\n", STATS_WEIGHT_BINS - 1);
+    }
+
+    printf("stats:\tframe\tpixels\tzero skip\trejected taps\tmean weight\taccepted taps per weight decade (>=1e-1 ...)\n");
+    for (f = 0; f < frames; f++) {
+        memset(&frame_total, 0, sizeof(frame_total));
+        zero_tile = rejected_tile = 0;
+        for (t = 0; t < tiles; t++) {
+            tile = &merged[f * tiles + t];
+            stats_add(&frame_total, tile);
+            if (stats_rate(tile->zero_pixels, tile->pixels) >
+                stats_rate(merged[f * tiles + zero_tile].zero_pixels, merged[f * tiles + zero_tile].pixels)) {
+                zero_tile = t;
+            }
+            if (stats_rate(tile->rejected_taps, tile->taps) >
+                stats_rate(merged[f * tiles + rejected_tile].rejected_taps, merged[f * tiles + rejected_tile].taps)) {
+                rejected_tile = t;
+            }
+            if (csv) {
+                fprintf(csv, "%d,%d,%d,%ld,%ld,%ld,%ld,%g", f, t % tiles_x, t / tiles_x, tile->pixels,
+                        tile->zero_pixels, tile->taps, tile->rejected_taps, tile->weight_sum);
+                for (i = 0; i < STATS_WEIGHT_BINS; i++) {
+                    fprintf(csv, ",%ld", tile->weight_bins[i]);
+                }
+                fprintf(csv, "\n");
+            }
+        }
+        if (frame_total.pixels == 0) {
+            continue;
+        }
+        accepted = frame_total.taps - frame_total.rejected_taps;
+        printf("\t%d\t%ld\t%.2f%%\t%.2f%%\t%.4f\t", f, frame_total.pixels,
+               stats_rate(frame_total.zero_pixels, frame_total.pixels),
+               stats_rate(frame_total.rejected_taps, frame_total.taps),
+               accepted ? frame_total.weight_sum / accepted : 0.0);
+        for (i = 0; i < STATS_WEIGHT_BINS; i++) {
+            printf(" %.1f%%", stats_rate(frame_total.weight_bins[i], accepted));
+        }
+        printf("\n");
+        tile = &merged[f * tiles + zero_tile];
+        printf("\t\tmost zero skips: tile (%d, %d) %.2f%%\n", zero_tile % tiles_x, zero_tile / tiles_x,
+               stats_rate(tile->zero_pixels, tile->pixels));
+        tile = &merged[f * tiles + rejected_tile];
+        printf("\t\tmost rejected taps: tile (%d, %d) %.2f%%\n", rejected_tile % tiles_x, rejected_tile / tiles_x,
+               stats_rate(tile->rejected_taps, tile->taps));
+    }
+    if (csv) {
+        fclose(csv);
+        printf("stats:\t%d tiles of %d frames written to %s\n", tiles, frames, csv_path);
+    }
+    free(merged);
+}
+
+#endif
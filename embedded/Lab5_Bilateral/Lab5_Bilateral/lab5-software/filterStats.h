@@ -0,0 +1,65 @@
+#ifndef _FILTER_STATS_H_
+#define _FILTER_STATS_H_
+
+/***********************************************************
+ * Workload counters of the filter hot path, built only with
+ * FILTER_STATS (make STATS=yes): pixels taken by the zero
+ * early exit, taps rejected by curPix > 0, and the range
+ * weights of the accepted taps. They are counted per frame
+ * and per STATS_TILE x STATS_TILE tile, by every thread into
+ * its own table; stats_report() merges the tables.
+ *
+ * Without FILTER_STATS the STATS_* macros expand to nothing
+ * and the filter is unchanged.
+ * *********************************************************/
+
+#ifdef FILTER_STATS
+
+#define STATS_TILE 16 // Tile side, in pixels
+#define STATS_WEIGHT_BINS 8 // Range weight decades: >= 1e-1, >= 1e-2, ... and the rest
+
+/**
+ * Counts of one tile of one frame.
+ * */
+typedef struct {
+    long pixels;         // Pixels filtered
+    long zero_pixels;    // Pixels taken by the in == 0 early exit
+    long taps;           // Taps of the other pixels
+    long rejected_taps;  // Taps skipped as curPix <= 0
+    double weight_sum;   // Range weights of the accepted taps
+    long weight_bins[STATS_WEIGHT_BINS]; // Accepted taps per range weight decade
+} filter_stats;
+
+// Frame filtered by the CPU paths, set by the thread that starts it
+extern int stats_frame_index;
+// Row filtered by the calling thread
+extern __thread int stats_row_index;
+
+#define STATS_FRAME(f) (stats_frame_index = (f))
+#define STATS_ROW(y) (stats_row_index = (y))
+
+// Sets the image size of the tile grid and clears all counts
+void stats_start(int size_x, int size_y);
+
+// Clears all counts, e.g. between backends
+void stats_reset(void);
+
+// Counts of the tile holding pixel (x, y) of frame, in the
+// table of the calling thread
+filter_stats *stats_tile(int frame, int x, int y);
+
+// Counts an accepted tap of range weight w
+void stats_weight(filter_stats *stats, float w);
+
+// Prints the counts of every frame and its extreme tiles.
+// FILTER_STATS_CSV names a file to write every tile to.
+void stats_report(void);
+
+#else
+
+#define STATS_FRAME(f)
+#define STATS_ROW(y)
+
+#endif
+
+#endif
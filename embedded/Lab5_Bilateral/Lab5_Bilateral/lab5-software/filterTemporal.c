@@ -0,0 +1,241 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "filterCommon.h"
+#include "filterBackend.h"
+#include "filterOmp.h"
+#include "filterTrace.h"
+#include "filterStats.h"
+
+/***********************************************************
+ * Spatio-temporal bilateral filter of depth video: every
+ * pixel is filtered over the (2r + 1)^2 window around it in
+ * the current frame and in the K frames before it, the taps
+ * of frame t - k weighted by exp(-k^2 / (2 sigma_t^2)) on
+ * top of the spatial and range weights of the direct
+ * kernel. Noise that changes from frame to frame averages
+ * out; depth edges, moving ones included, stop it as they
+ * stop the spatial smoothing. With K = 0 it is the direct
+ * kernel.
+ *
+ * The frames of the window stay resident in a ring buffer of
+ * K + 1 uint16 frames, in depth units: a frame is converted
+ * once, as it enters the ring, and read by the K + 1
+ * windows it belongs to. The weights are tabled once per
+ * call: the spatio-temporal ones per tap, the range ones
+ * per depth difference, which is a whole number of depth
+ * units, so the taps cost no exp. Float frames are rounded
+ * to depth units as they enter the ring; the input files
+ * already hold whole millimetres.
+ *
+ * The frames of one filter call are one clip: the first
+ * ones have a shorter window. Taps are addressed as in
+ * bilateralFilterRowTaps, unsigned and clamped to the last
+ * row and column. FILTER_TEMPORAL_FRAMES sets K
+ * (TEMPORAL_FRAMES), FILTER_TEMPORAL_SIGMA sigma_t in frames
+ * (TEMPORAL_SIGMA).
+ * *********************************************************/
+
+#define TEMPORAL_FRAMES 2 // Default previous frames of the window
+#define TEMPORAL_MAX_FRAMES 15 // Most previous frames of the window
+#define TEMPORAL_SIGMA 1.0f // Default temporal sigma, in frames
+#define TEMPORAL_RANGE_UNITS 1024 // Depth differences of a range weight, the others weigh 0
+#define TEMPORAL_TAPS ((2 * FILTER_MAX_RADIUS + 1) * (2 * FILTER_MAX_RADIUS + 1))
+
+// Ring buffer of the window, ring_slots frames of ring_pixels
+static uint16_t *ring;
+static size_t ring_pixels;
+static int ring_slots;
+// Previous frames of the window, and their sigma
+static int temporal_k;
+static float temporal_sigma;
+// Weight of tap (i, j) of frame t - k, at [k][(j + r) * (2r + 1) + i + r]
+static float temporal_weights[TEMPORAL_MAX_FRAMES + 1][TEMPORAL_TAPS];
+// Range weight of a depth difference of d depth units
+static float temporal_range[TEMPORAL_RANGE_UNITS];
+
+static int temporal_open(const char *xclbin){
+    const char *frames = getenv("FILTER_TEMPORAL_FRAMES");
+    const char *sigma = getenv("FILTER_TEMPORAL_SIGMA");
+
+    temporal_k = frames ? atoi(frames) : TEMPORAL_FRAMES;
+    temporal_sigma = sigma ? (float) atof(sigma) : TEMPORAL_SIGMA;
+    if (temporal_k < 0 || temporal_k > TEMPORAL_MAX_FRAMES) {
+        printf("Error: FILTER_TEMPORAL_FRAMES must be 0 to %d\n", TEMPORAL_MAX_FRAMES);
+        return -1;
+    }
+    if (temporal_sigma <= 0.0f) {
+        printf("Error: FILTER_TEMPORAL_SIGMA must be positive\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void temporal_close(void){
+    free(ring);
+    ring = NULL;
+    ring_pixels = 0;
+    ring_slots = 0;
+}
+
+/***********************************************************
+ * Function:  temporal_setup
+ * ---------------------------------------------------------
+ * Grows the ring to K + 1 frames and tables the weights.
+ * Returns 0 on success.
+ * *********************************************************/
+static int temporal_setup(const float *gaussian, int size_x, int size_y, int r){
+    size_t pixels = (size_t) size_x * size_y;
+    int d, i, j, k;
+
+    if (r > FILTER_MAX_RADIUS) {
+        printf("Error: radius %d is larger than %d\n", r, FILTER_MAX_RADIUS);
+        return -1;
+    }
+    if (pixels > ring_pixels || temporal_k + 1 > ring_slots) {
+        free(ring);
+        ring = (uint16_t *) malloc(sizeof(uint16_t) * pixels * (temporal_k + 1));
+        ring_pixels = ring ? pixels : 0;
+        ring_slots = ring ? temporal_k + 1 : 0;
+        if (ring == NULL) {
+            printf("Error: Failed to allocate the temporal ring buffer\n");
+            return -1;
+        }
+    }
+    for (k = 0; k <= temporal_k; k++) {
+        const float w = expf(-(float) (k * k) / (2.0f * temporal_sigma * temporal_sigma));
+
+        for (j = -r; j <= r; j++) {
+            for (i = -r; i <= r; i++) {
+                temporal_weights[k][(j + r) * (2 * r + 1) + i + r] = gaussian[i + r] * gaussian[j + r] * w;
+            }
+        }
+    }
+    for (d = 0; d < TEMPORAL_RANGE_UNITS; d++) {
+        const float m = d / DEPTH_UNITS;
+
+        temporal_range[d] = expf(-m * m / 0.02f);
+    }
+    return 0;
+}
+
+/***********************************************************
+ * Function:  temporal_frame
+ * ---------------------------------------------------------
+ * Filters frames[0] over it and the window - 1 frames
+ * before it, frames[k] being frame t - k. The rows are
+ * shared between the OpenMP threads.
+ * *********************************************************/
+static void temporal_frame(float *out, const uint16_t *const *frames, int window, int size_x, int size_y, int r){
+    int y;
+
+    #pragma omp parallel for schedule(static)
+    for (y = 0; y < size_y; y++) {
+        const uint16_t *rows[TEMPORAL_MAX_FRAMES + 1][2 * FILTER_MAX_RADIUS + 1];
+        const uint16_t *in = frames[0] + (long) y * size_x;
+        unsigned int x;
+        int i, j, k;
+
+        for (k = 0; k < window; k++) {
+            for (j = -r; j <= r; j++) {
+                rows[k][j + r] = frames[k] + MIN((unsigned int) (y + j), (unsigned int) size_y - 1) * size_x;
+            }
+        }
+        for (x = 0; x < (unsigned int) size_x; x++) {
+            const int center = in[x];
+            float t = 0.0f, sum = 0.0f;
+
+            if (center == 0) {
+                out[(long) y * size_x + x] = 0;
+                continue;
+            }
+            for (k = 0; k < window; k++) {
+                const float *weights = temporal_weights[k];
+
+                for (j = 0; j <= 2 * r; j++) {
+                    const uint16_t *row = rows[k][j];
+
+                    for (i = -r; i <= r; i++) {
+                        const int v = row[MIN(x + i, (unsigned int) size_x - 1)];
+                        const int d = abs(v - center);
+
+                        if (v != 0 && d < TEMPORAL_RANGE_UNITS) {
+                            const float w = weights[j * (2 * r + 1) + i + r] * temporal_range[d];
+                            t += w * v;
+                            sum += w;
+                        }
+                    }
+                }
+            }
+            out[(long) y * size_x + x] = t / sum / DEPTH_UNITS;
+        }
+    }
+}
+
+/***********************************************************
+ * Function:  temporal_clip
+ * ---------------------------------------------------------
+ * Runs the frames of one call through the ring: frame f
+ * enters slot f % (K + 1), converted by enter, and is
+ * filtered with the frames before it still in the ring.
+ * *********************************************************/
+static void temporal_clip(float *out, const void *in, size_t frame_bytes, int size_x, int size_y, int r,
+                          int frames, void (*enter)(uint16_t *slot, const void *frame, size_t pixels)){
+    const size_t pixels = (size_t) size_x * size_y;
+    const uint16_t *window[TEMPORAL_MAX_FRAMES + 1];
+    int f, k, slots = temporal_k + 1;
+
+    for (f = 0; f < frames; f++) {
+        trace_begin("frame");
+        STATS_FRAME(f);
+        enter(ring + (f % slots) * pixels, (const char *) in + f * frame_bytes, pixels);
+        for (k = 0; k <= MIN(f, temporal_k); k++) {
+            window[k] = ring + ((f - k) % slots) * pixels;
+        }
+        temporal_frame(out + f * pixels, window, k, size_x, size_y, r);
+        trace_end();
+    }
+}
+
+// Rounds a float frame to depth units, into a ring slot
+static void temporal_enter_f32(uint16_t *slot, const void *frame, size_t pixels){
+    const float *in = (const float *) frame;
+    size_t i;
+
+    for (i = 0; i < pixels; i++) {
+        slot[i] = depth_from_float(in[i]);
+    }
+}
+
+// Copies a uint16 frame into a ring slot
+static void temporal_enter_u16(uint16_t *slot, const void *frame, size_t pixels){
+    memcpy(slot, frame, sizeof(uint16_t) * pixels);
+}
+
+/***********************************************************
+ * Function:  temporal_filter
+ * *********************************************************/
+static int temporal_filter(float *out, const float *in, const float *gaussian, int size_x, int size_y, int r,
+                           int frames){
+    if (temporal_setup(gaussian, size_x, size_y, r) != 0) {
+        return -1;
+    }
+    temporal_clip(out, in, sizeof(float) * size_x * size_y, size_x, size_y, r, frames, temporal_enter_f32);
+    return 0;
+}
+
+/***********************************************************
+ * Function:  temporal_filter_u16
+ * *********************************************************/
+static int temporal_filter_u16(float *out, const uint16_t *in, const float *gaussian, int size_x, int size_y,
+                               int r, int frames){
+    if (temporal_setup(gaussian, size_x, size_y, r) != 0) {
+        return -1;
+    }
+    temporal_clip(out, in, sizeof(uint16_t) * size_x * size_y, size_x, size_y, r, frames, temporal_enter_u16);
+    return 0;
+}
+
+const filter_backend temporal_backend = {"temporal", temporal_open, temporal_filter, temporal_filter_u16,
+                                         temporal_close, 0};
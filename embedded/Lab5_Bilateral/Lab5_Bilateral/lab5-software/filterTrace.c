@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "filterTrace.h"
+
+/**
+ * A closed span: start and end in nanoseconds of
+ * CLOCK_MONOTONIC.
+ * */
+typedef struct {
+    const char *name;
+    int64_t start, end;
+} trace_span;
+
+/**
+ * Spans of one thread. Only its thread appends to it; the
+ * list of buffers is shared, under trace_lock.
+ * */
+typedef struct trace_buffer {
+    int tid;
+    trace_span *spans;
+    int count, capacity;
+    struct trace_buffer *next;
+} trace_buffer;
+
+// Recording state, set by trace_start()
+static volatile int trace_on;
+static const char *trace_path;
+static int64_t trace_origin;
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_buffer *trace_buffers;
+static int trace_threads;
+
+// Open spans and buffer of the calling thread
+static __thread const char *open_names[TRACE_MAX_DEPTH];
+static __thread int64_t open_starts[TRACE_MAX_DEPTH];
+static __thread int open_depth;
+static __thread trace_buffer *thread_buffer;
+
+static int64_t trace_now(void){
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/***********************************************************
+ * Function:  trace_start
+ * *********************************************************/
+void trace_start(const char *path){
+    if (!path || !*path) {
+        return;
+    }
+    trace_path = path;
+    trace_origin = trace_now();
+    trace_on = 1;
+}
+
+/***********************************************************
+ * Function:  trace_begin
+ * ---------------------------------------------------------
+ * Spans deeper than TRACE_MAX_DEPTH are counted, so that
+ * their trace_end() still matches, but not timed.
+ * *********************************************************/
+void trace_begin(const char *name){
+    if (open_depth < TRACE_MAX_DEPTH) {
+        open_names[open_depth] = name;
+        open_starts[open_depth] = trace_now();
+    }
+    open_depth++;
+}
+
+// Buffer of the calling thread, registered on first use
+static trace_buffer *trace_thread_buffer(void){
+    if (!thread_buffer) {
+        thread_buffer = (trace_buffer *) calloc(1, sizeof(trace_buffer));
+        if (thread_buffer == NULL) {
+            printf("Error: Failed to allocate a trace buffer\n");
+            exit(EXIT_FAILURE);
+        }
+        pthread_mutex_lock(&trace_lock);
+        thread_buffer->tid = trace_threads++;
+        thread_buffer->next = trace_buffers;
+        trace_buffers = thread_buffer;
+        pthread_mutex_unlock(&trace_lock);
+    }
+    return thread_buffer;
+}
+
+/***********************************************************
+ * Function:  trace_end
+ * *********************************************************/
+double trace_end(void){
+    int64_t end = trace_now();
+    trace_buffer *buffer;
+    trace_span *span;
+
+    if (open_depth == 0) {
+        return 0.0;
+    }
+    if (--open_depth >= TRACE_MAX_DEPTH) {
+        return 0.0;
+    }
+    if (trace_on) {
+        buffer = trace_thread_buffer();
+        if (buffer->count == buffer->capacity) {
+            buffer->capacity = buffer->capacity ? 2 * buffer->capacity : 256;
+            buffer->spans = (trace_span *) realloc(buffer->spans, sizeof(trace_span) * buffer->capacity);
+            if (buffer->spans == NULL) {
+                printf("Error: Failed to allocate trace spans\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        span = &buffer->spans[buffer->count++];
+        span->name = open_names[open_depth];
+        span->start = open_starts[open_depth];
+        span->end = end;
+    }
+    return (end - open_starts[open_depth]) / 1e6;
+}
+
+/***********************************************************
+ * Function:  trace_stop
+ * ---------------------------------------------------------
+ * Writes one complete event ("ph":"X") per span, with
+ * microsecond timestamps from trace_start(), and one thread
+ * name per buffer. Threads are numbered in the order they
+ * first closed a recorded span.
+ * *********************************************************/
+void trace_stop(void){
+    trace_buffer *buffer;
+    FILE *fptr;
+    int i, first = 1, spans = 0;
+
+    if (!trace_on) {
+        return;
+    }
+    trace_on = 0;
+    if ((fptr = fopen(trace_path, "w")) == NULL) {
+        printf("Error: Failed to open trace file %s\n", trace_path);
+    } else {
+        fprintf(fptr, "{\"traceEvents\":[\n");
+        for (buffer = trace_buffers; buffer; buffer = buffer->next) {
+            fprintf(fptr, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                    "\"args\":{\"name\":\"thread %d\"}}", first ? "" : ",\n", buffer->tid, buffer->tid);
+            first = 0;
+            for (i = 0; i < buffer->count; i++) {
+                const trace_span *span = &buffer->spans[i];
+                fprintf(fptr, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        span->name, buffer->tid, (span->start - trace_origin) / 1e3,
+                        (span->end - span->start) / 1e3);
+            }
+            spans += buffer->count;
+        }
+        fprintf(fptr, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        fclose(fptr);
+        printf("trace:\t%d spans of %d threads written to %s\n", spans, trace_threads, trace_path);
+    }
+
+    // The threads keep their buffers, emptied for a later trace
+    pthread_mutex_lock(&trace_lock);
+    for (buffer = trace_buffers; buffer; buffer = buffer->next) {
+        buffer->count = 0;
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
@@ -0,0 +1,51 @@
+#ifndef _FILTER_TRACE_H_
+#define _FILTER_TRACE_H_
+
+/***********************************************************
+ * Tracing of the software and hardware hosts. A span times
+ * a piece of work on the calling thread: trace_begin() opens
+ * it, trace_end() closes the innermost open span of the
+ * thread and returns its milliseconds, so spans nest and
+ * threads never share state.
+ *
+ * Spans are always timed. They are only recorded once
+ * trace_start() was given a file, each thread into its own
+ * buffer, and trace_stop() writes them in the Chrome trace
+ * event format (chrome://tracing, ui.perfetto.dev). Both
+ * hosts trace to the file named by FILTER_TRACE:
+ *
+ *   FILTER_TRACE=trace.json ./filter all 8
+ * *********************************************************/
+
+#define TRACE_MAX_DEPTH 16 // Deepest nesting of open spans on one thread
+
+// Starts recording spans, to be written to path by trace_stop().
+// A NULL path leaves recording off.
+void trace_start(const char *path);
+
+// Writes the recorded spans of all threads and stops recording.
+// Call once no other thread traces any more.
+void trace_stop(void);
+
+// Opens a span called name on the calling thread. name must
+// outlive the trace, e.g. a string literal.
+void trace_begin(const char *name);
+
+// Closes the innermost open span of the calling thread, and
+// returns its milliseconds.
+double trace_end(void);
+
+// Closes the span of a TRACE_SCOPE variable
+static inline void trace_scope_end(const char **scope){
+    (void) scope;
+    trace_end();
+}
+
+// Span called name from here to the end of the enclosing block
+#define TRACE_SCOPE_VAR(line) trace_scope_ ## line
+#define TRACE_SCOPE_AT(name, line) \
+    const char *TRACE_SCOPE_VAR(line) __attribute__((cleanup(trace_scope_end), unused)) = \
+        (trace_begin(name), name)
+#define TRACE_SCOPE(name) TRACE_SCOPE_AT(name, __LINE__)
+
+#endif
@@ -0,0 +1,380 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lodepng.h"
+#include "bitmap.h"
+#include "filterCommon.h"
+#include "filterOmp.h"
+#include "filterTrace.h"
+
+/***********************************************************
+ * Joint bilateral upsampling (Kopf et al., SIGGRAPH 2007) of
+ * a low resolution depth frame with a full resolution guide
+ * image, for depth sensors that run at a fraction of the
+ * colour camera resolution.
+ *
+ * Every full resolution pixel is computed directly from the
+ * (2r + 1)^2 low resolution depths around it, weighted by
+ * their spatial distance in low resolution pixels and by the
+ * guide difference between the pixel and the low resolution
+ * sample. Covering the same footprint at full resolution,
+ * as upsampling and then filtering does, takes
+ * (2 r scale + 1)^2 taps: about scale^2 times the work.
+ *
+ * The guide is a PNG (lodepng), an uncompressed 24 bit BMP
+ * (BitmapInterface), both as RGB in [0, 1], or raw floats
+ * of channels per pixel, e.g. from filterGen guide=<N>.
+ * Zero depths are invalid: they carry no weight, and a
+ * pixel without a valid tap is zero.
+ *
+ * With input=<file> a full resolution depth frame is
+ * decimated to the low resolution one, as the sensor would
+ * sample it, and is the reference of the error report. The
+ * full resolution pipeline of today, nearest upsampling and
+ * the direct kernel, is timed against it:
+ *
+ *   ./filterGen 1280 720 guide=3 out=hd_
+ *   ./filterUpsample 1280 720 input=hd_input.bin guide=hd_guide.bin scale=4
+ * *********************************************************/
+
+#define UPSAMPLE_SCALE 4 // Default resolution ratio
+#define UPSAMPLE_CHANNELS 3 // Channels of raw guides by default
+#define UPSAMPLE_MAX_CHANNELS 8 // Most guide channels
+#define UPSAMPLE_SIGMA_C 0.1f // Default range sigma of the guide channels
+
+/**
+ * Files and parameters of one run, from the command line.
+ * */
+typedef struct {
+    const char *depth, *input, *guide, *out;
+    int scale, channels;
+    float sigma_s, sigma_c;
+} upsample_params;
+
+// Takes one key=value argument into p, or returns -1 for an unknown key
+static int upsample_option(upsample_params *p, const char *arg){
+    const char *value;
+
+    if ((value = option_value(arg, "depth"))) {
+        p->depth = value;
+    } else if ((value = option_value(arg, "input"))) {
+        p->input = value;
+    } else if ((value = option_value(arg, "guide"))) {
+        p->guide = value;
+    } else if ((value = option_value(arg, "scale"))) {
+        p->scale = atoi(value);
+    } else if ((value = option_value(arg, "channels"))) {
+        p->channels = atoi(value);
+    } else if ((value = option_value(arg, "sigma_s"))) {
+        p->sigma_s = (float) atof(value);
+    } else if ((value = option_value(arg, "sigma_c"))) {
+        p->sigma_c = (float) atof(value);
+    } else if ((value = option_value(arg, "out"))) {
+        p->out = value;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Non zero if path ends in suffix
+static int upsample_has_suffix(const char *path, const char *suffix){
+    size_t n = strlen(path), m = strlen(suffix);
+
+    return n >= m && strcmp(path + n - m, suffix) == 0;
+}
+
+/***********************************************************
+ * Function:  upsample_guide
+ * ---------------------------------------------------------
+ * Loads the guide into a new array of channels floats per
+ * pixel, or returns NULL. Images must be size_x x size_y
+ * and give 3 channels; raw guides give p->channels.
+ * *********************************************************/
+static float *upsample_guide(const upsample_params *p, int size_x, int size_y, int *channels){
+    const long pixels = (long) size_x * size_y;
+    float *guide;
+    long i;
+    int c;
+
+    if (upsample_has_suffix(p->guide, ".png")) {
+        unsigned char *rgb = NULL;
+        unsigned w, h, error;
+
+        if ((error = lodepng_decode24_file(&rgb, &w, &h, p->guide)) != 0) {
+            printf("Error: %s: %s\n", p->guide, lodepng_error_text(error));
+            return NULL;
+        }
+        if ((int) w != size_x || (int) h != size_y) {
+            printf("Error: %s is %ux%u, not %dx%d\n", p->guide, w, h, size_x, size_y);
+            free(rgb);
+            return NULL;
+        }
+        guide = (float *) frame_alloc(sizeof(float) * pixels * 3);
+        for (i = 0; i < pixels * 3; i++) {
+            guide[i] = rgb[i] / 255.0f;
+        }
+        free(rgb);
+        *channels = 3;
+        return guide;
+    }
+
+    if (upsample_has_suffix(p->guide, ".bmp")) {
+        BitmapInterface bmp(p->guide);
+        int x, y, row, pixel;
+
+        if (!bmp.readBitmapFile()) {
+            return NULL;
+        }
+        if (bmp.getWidth() != size_x || abs(bmp.getHeight()) != size_y || (long) bmp.numPixels() < pixels) {
+            printf("Error: %s is %dx%d, not %dx%d\n", p->guide, bmp.getWidth(), abs(bmp.getHeight()), size_x, size_y);
+            return NULL;
+        }
+        guide = (float *) frame_alloc(sizeof(float) * pixels * 3);
+        for (y = 0; y < size_y; y++) {
+            // Rows are stored bottom up unless the height is negative
+            row = bmp.getHeight() > 0 ? size_y - 1 - y : y;
+            for (x = 0; x < size_x; x++) {
+                pixel = bmp.bitmap()[(long) row * size_x + x]; // B, G, R from the low byte up
+                for (c = 0; c < 3; c++) {
+                    guide[((long) y * size_x + x) * 3 + c] = ((pixel >> (8 * (2 - c))) & 0xff) / 255.0f;
+                }
+            }
+        }
+        *channels = 3;
+        return guide;
+    }
+
+    guide = (float *) frame_alloc(sizeof(float) * pixels * p->channels);
+    if (read_floats(p->guide, guide, pixels * p->channels) != 0) {
+        free(guide);
+        return NULL;
+    }
+    *channels = p->channels;
+    return guide;
+}
+
+/***********************************************************
+ * Function:  joint_upsample
+ * ---------------------------------------------------------
+ * Fills the size_x x size_y out from the size_x / scale x
+ * size_y / scale depth. Low resolution pixel (i, j) samples
+ * the guide at the centre of its scale x scale block, as
+ * the decimation of main() does; these samples are gathered
+ * into a low resolution guide first. The spatial weights
+ * depend only on the position of a pixel in its block, so
+ * they are tabled per position and axis, and a tap costs
+ * one expf, of its guide distance.
+ * *********************************************************/
+static int joint_upsample(float *out, const float *depth, const float *guide, int channels, int size_x, int size_y,
+                          int scale, int r, float sigma_s, float sigma_c){
+    const int lo_x = size_x / scale, lo_y = size_y / scale, taps = 2 * r + 1;
+    float *sampled = (float *) malloc(sizeof(float) * lo_x * lo_y * channels);
+    float *spatial = (float *) malloc(sizeof(float) * scale * taps);
+    int i, j, c, y;
+
+    if (sampled == NULL || spatial == NULL) {
+        printf("Error: Failed to allocate the upsampling tables\n");
+        free(sampled);
+        free(spatial);
+        return -1;
+    }
+    // spatial[k * taps + t]: weight of tap t - r from the block
+    // of the pixel at position k of its block, in low resolution
+    // pixels from the pixel centre
+    for (i = 0; i < scale; i++) {
+        const float u = (i + 0.5f) / scale - 0.5f;
+        for (j = 0; j < taps; j++) {
+            const float d = j - r - u;
+            spatial[i * taps + j] = expf(-d * d / (2.0f * sigma_s * sigma_s));
+        }
+    }
+    for (j = 0; j < lo_y; j++) {
+        for (i = 0; i < lo_x; i++) {
+            for (c = 0; c < channels; c++) {
+                sampled[((long) j * lo_x + i) * channels + c] =
+                    guide[((long) (j * scale + scale / 2) * size_x + i * scale + scale / 2) * channels + c];
+            }
+        }
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (y = 0; y < size_y; y++) {
+        const float *wy = spatial + (y % scale) * taps;
+        const int j0 = y / scale;
+        const float range = 0.5f / (sigma_c * sigma_c);
+        int x, i, j, c;
+
+        for (x = 0; x < size_x; x++) {
+            const float *wx = spatial + (x % scale) * taps;
+            const int i0 = x / scale;
+            const float *center = guide + ((long) y * size_x + x) * channels;
+            float sum = 0.0f, weight = 0.0f;
+
+            for (j = MAX(0, j0 - r); j <= MIN(lo_y - 1, j0 + r); j++) {
+                for (i = MAX(0, i0 - r); i <= MIN(lo_x - 1, i0 + r); i++) {
+                    const float d = depth[(long) j * lo_x + i];
+                    const float *sample = sampled + ((long) j * lo_x + i) * channels;
+                    float e = 0.0f, w;
+
+                    if (d == 0) {
+                        continue;
+                    }
+                    for (c = 0; c < channels; c++) {
+                        e += (sample[c] - center[c]) * (sample[c] - center[c]);
+                    }
+                    w = wy[j - j0 + r] * wx[i - i0 + r] * expf(-e * range);
+                    sum += w * d;
+                    weight += w;
+                }
+            }
+            out[(long) y * size_x + x] = weight > 0.0f ? sum / weight : 0.0f;
+        }
+    }
+    free(sampled);
+    free(spatial);
+    return 0;
+}
+
+/***********************************************************
+ * Function:  upsample_error
+ * ---------------------------------------------------------
+ * Prints the RMSE in millimetres of out against the
+ * reference, over the pixels valid in both, and the share
+ * of the reference pixels out leaves invalid.
+ * *********************************************************/
+static void upsample_error(const char *name, double ms, const float *out, const float *reference, long pixels,
+                           const char *note){
+    double sum = 0.0, diff;
+    long i, valid = 0, lost = 0;
+
+    printf("%s:\t%.3f ms", name, ms);
+    if (reference) {
+        for (i = 0; i < pixels; i++) {
+            if (reference[i] == 0) {
+                continue;
+            }
+            if (out[i] == 0) {
+                lost++;
+                continue;
+            }
+            diff = out[i] - reference[i];
+            sum += diff * diff;
+            valid++;
+        }
+        printf("\tRMSE %.3f mm\tholes %.2f%%", valid ? sqrt(sum / valid) * DEPTH_UNITS : 0.0,
+               100.0 * lost / MAX(valid + lost, 1L));
+    }
+    printf("\t%s\n", note);
+}
+
+/***********************************************************
+ * Function:  main
+ * *********************************************************/
+int main(int argc, char *argv[]){
+    upsample_params p = {NULL, NULL, NULL, NULL, UPSAMPLE_SCALE, UPSAMPLE_CHANNELS, 0.0f, UPSAMPLE_SIGMA_C};
+    float gaussian[FILTER_SIZE];
+    float *reference = NULL, *depth, *guide, *jbu, *nearest, *baseline;
+    char note[128];
+    int size_x = 0, size_y = 0, lo_x, lo_y, channels = 0, i, x, y, failed = 0;
+    long pixels;
+    double jbu_ms, baseline_ms;
+    FILE *fptr;
+
+    if (argc > 2) {
+        size_x = atoi(argv[1]);
+        size_y = atoi(argv[2]);
+    }
+    for (i = 3; i < argc && !failed; i++) {
+        failed = upsample_option(&p, argv[i]);
+    }
+    if (failed || size_x < 1 || size_y < 1 || !p.guide || !p.depth == !p.input || p.scale < 1 ||
+        size_x % p.scale != 0 || size_y % p.scale != 0 || p.channels < 1 || p.channels > UPSAMPLE_MAX_CHANNELS ||
+        p.sigma_s < 0 || p.sigma_c <= 0) {
+        printf("Usage: %s <width> <height> guide=<file> depth=<file>|input=<file> [key=value ...]\n", argv[0]);
+        printf("  width, height    full resolution, of the guide and the output, multiples of scale\n");
+        printf("  guide=<file>     .png or 24 bit .bmp (RGB), or raw floats of channels per pixel\n");
+        printf("  depth=<file>     low resolution depth frame, width/scale x height/scale\n");
+        printf("  input=<file>     full resolution depth frame to decimate, and compare against\n");
+        printf("  scale=<N>        resolution ratio (%d)\n", UPSAMPLE_SCALE);
+        printf("  channels=<N>     channels of a raw guide (%d)\n", UPSAMPLE_CHANNELS);
+        printf("  sigma_s=<px>     spatial sigma in low resolution pixels (of the filter vector)\n");
+        printf("  sigma_c=<v>      range sigma of the guide channels (%g)\n", UPSAMPLE_SIGMA_C);
+        printf("  out=<file>       writes the upsampled frame\n");
+        return EXIT_FAILURE;
+    }
+
+    make_gaussian(gaussian);
+    if (p.sigma_s == 0.0f) {
+        p.sigma_s = filter_sigma_s(gaussian, FILTER_RADIUS);
+    }
+    pixels = (long) size_x * size_y;
+    lo_x = size_x / p.scale;
+    lo_y = size_y / p.scale;
+    depth = (float *) frame_alloc(sizeof(float) * lo_x * lo_y);
+    if (p.input) {
+        reference = (float *) frame_alloc(sizeof(float) * pixels);
+        if (read_floats(p.input, reference, pixels) != 0) {
+            return EXIT_FAILURE;
+        }
+        for (y = 0; y < lo_y; y++) {
+            for (x = 0; x < lo_x; x++) {
+                depth[y * lo_x + x] = reference[(long) (y * p.scale + p.scale / 2) * size_x + x * p.scale + p.scale / 2];
+            }
+        }
+    } else if (read_floats(p.depth, depth, (long) lo_x * lo_y) != 0) {
+        return EXIT_FAILURE;
+    }
+    if ((guide = upsample_guide(&p, size_x, size_y, &channels)) == NULL) {
+        return EXIT_FAILURE;
+    }
+    jbu = (float *) frame_alloc(sizeof(float) * pixels);
+    nearest = (float *) frame_alloc(sizeof(float) * pixels);
+    baseline = (float *) frame_alloc(sizeof(float) * pixels);
+
+    trace_start(getenv("FILTER_TRACE"));
+    printf("upsample:\t%dx%d from %dx%d\tscale %d\tguide %d channels\tsigma_s %g\tsigma_c %g\n", size_x, size_y,
+           lo_x, lo_y, p.scale, channels, p.sigma_s, p.sigma_c);
+
+    trace_begin("joint upsample");
+    if (joint_upsample(jbu, depth, guide, channels, size_x, size_y, p.scale, FILTER_RADIUS, p.sigma_s, p.sigma_c) != 0) {
+        return EXIT_FAILURE;
+    }
+    jbu_ms = trace_end();
+
+    // Today's pipeline: nearest upsampling, then the direct kernel at full resolution
+    trace_begin("upsample and filter");
+    for (y = 0; y < size_y; y++) {
+        for (x = 0; x < size_x; x++) {
+            nearest[(long) y * size_x + x] = depth[(y / p.scale) * lo_x + x / p.scale];
+        }
+    }
+    bilateralFilterBand(baseline, nearest, gaussian, size_x, size_y, FILTER_RADIUS, 0, size_y);
+    baseline_ms = trace_end();
+    trace_stop();
+
+    snprintf(note, sizeof(note), "%d low resolution taps per pixel, %d for its footprint at full resolution",
+             FILTER_SIZE * FILTER_SIZE, (2 * FILTER_RADIUS * p.scale + 1) * (2 * FILTER_RADIUS * p.scale + 1));
+    upsample_error("joint", jbu_ms, jbu, reference, pixels, note);
+    snprintf(note, sizeof(note), "nearest upsampling, then %d taps per pixel", FILTER_SIZE * FILTER_SIZE);
+    upsample_error("baseline", baseline_ms, baseline, reference, pixels, note);
+
+    if (p.out) {
+        if ((fptr = fopen(p.out, "wb")) == NULL || fwrite(jbu, sizeof(float), pixels, fptr) != (size_t) pixels) {
+            printf("Error: Failed to write %s\n", p.out);
+            failed = 1;
+        }
+        if (fptr) {
+            fclose(fptr);
+        }
+    }
+
+    free(reference);
+    free(depth);
+    free(guide);
+    free(jbu);
+    free(nearest);
+    free(baseline);
+    return failed ? EXIT_FAILURE : 0;
+}